@@ -0,0 +1,75 @@
+/*
+ * Copyright © 2019 Paweł Dziepak
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include "codegen/arithmetic_ops.hpp"
+#include "codegen/compiler.hpp"
+#include "codegen/module.hpp"
+#include "codegen/module_builder.hpp"
+#include "codegen/statements.hpp"
+
+namespace cg = codegen;
+
+namespace {
+
+// x^(2^depth) computed by repeated squaring. Without let each level doubles the size of the expression.
+template<bool UseLet, size_t Depth, typename Value> auto power(Value x) {
+  if constexpr (Depth == 0) {
+    return x;
+  } else if constexpr (UseLet) {
+    auto square = cg::let(x * x);
+    return power<UseLet, Depth - 1>(square);
+  } else {
+    return power<UseLet, Depth - 1>(x * x);
+  }
+}
+
+template<bool UseLet> void build_and_compile(benchmark::State& state) {
+  constexpr auto depth = 10;
+  auto instructions = size_t(0);
+  for (auto _ : state) {
+    auto comp = cg::compiler{};
+    auto builder = cg::module_builder(comp, "expressions");
+    auto fn = builder.create_function<uint64_t(uint64_t)>(
+        "power", [](cg::value<uint64_t> x) { cg::return_(power<UseLet, depth>(x)); });
+    instructions = 0;
+    for (auto& f : *builder.module_) { instructions += f.getInstructionCount(); }
+    auto module = std::move(builder).build();
+    benchmark::DoNotOptimize(module.get_address(fn));
+  }
+  state.counters["instructions"] = instructions;
+}
+
+} // namespace
+
+static void expression_without_let(benchmark::State& state) {
+  build_and_compile<false>(state);
+}
+BENCHMARK(expression_without_let)->Unit(benchmark::kMillisecond);
+
+static void expression_with_let(benchmark::State& state) {
+  build_and_compile<true>(state);
+}
+BENCHMARK(expression_with_let)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
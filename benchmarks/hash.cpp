@@ -0,0 +1,218 @@
+/*
+ * Copyright © 2019 Paweł Dziepak
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "codegen/hash.hpp"
+
+#include <array>
+#include <cstring>
+#include <functional>
+#include <string_view>
+#include <vector>
+
+#if defined(__SSE4_2__)
+#include <nmmintrin.h>
+#endif
+
+#include <benchmark/benchmark.h>
+
+#include "codegen/arithmetic_ops.hpp"
+#include "codegen/compiler.hpp"
+#include "codegen/literals.hpp"
+#include "codegen/module.hpp"
+#include "codegen/module_builder.hpp"
+#include "codegen/relational_ops.hpp"
+#include "codegen/statements.hpp"
+#include "codegen/variable.hpp"
+
+namespace cg = codegen;
+using namespace cg::literals;
+
+namespace {
+
+std::vector<uint64_t> make_words(size_t n) {
+  auto words = std::vector<uint64_t>(n);
+  auto state = uint64_t(0x9e3779b97f4a7c15);
+  for (auto& w : words) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    w = state;
+  }
+  return words;
+}
+
+constexpr auto crc32c_table = [] {
+  auto table = std::array<uint32_t, 256>{};
+  for (uint32_t i = 0; i < 256; i++) {
+    auto crc = i;
+    for (auto j = 0; j < 8; j++) { crc = (crc >> 1) ^ (crc & 1 ? 0x82f63b78 : 0); }
+    table[i] = crc;
+  }
+  return table;
+}();
+
+uint32_t crc32c_table_words(uint64_t const* data, uint64_t n) {
+  auto crc = ~uint32_t(0);
+  for (auto i = uint64_t(0); i < n; i++) {
+    for (auto j = 0; j < 8; j++) { crc = crc32c_table[(crc ^ (data[i] >> (j * 8))) & 0xff] ^ (crc >> 8); }
+  }
+  return ~crc;
+}
+
+#if defined(__SSE4_2__)
+uint32_t crc32c_sse42_words(uint64_t const* data, uint64_t n) {
+  auto crc = uint64_t(~uint32_t(0));
+  for (auto i = uint64_t(0); i < n; i++) { crc = _mm_crc32_u64(crc, data[i]); }
+  return ~uint32_t(crc);
+}
+#endif
+
+uint64_t hash_combine(uint64_t state, uint64_t v) {
+  auto product = static_cast<unsigned __int128>(state ^ 0xa0761d6478bd642full) * (v ^ 0xe7037ed1a0b428dbull);
+  return uint64_t(product) ^ uint64_t(product >> 64);
+}
+
+uint64_t hash_bytes(std::byte const* data, uint64_t n) {
+  auto state = uint64_t(0);
+  auto offset = uint64_t(0);
+  for (; offset + 8 <= n; offset += 8) {
+    auto word = uint64_t{};
+    std::memcpy(&word, data + offset, sizeof(word));
+    state = hash_combine(state, word);
+  }
+  auto tail = uint64_t(0);
+  for (auto i = 0u; offset + i < n; i++) { tail |= uint64_t(data[offset + i]) << (i * 8); }
+  return hash_combine(hash_combine(state, tail), n);
+}
+
+} // namespace
+
+static void crc32c_codegen(benchmark::State& state) {
+  auto comp = cg::compiler{};
+  auto builder = cg::module_builder(comp, "crc32c");
+  auto crc32c = builder.create_function<uint32_t(uint64_t const*, uint64_t)>(
+      "crc32c", [](cg::value<uint64_t const*> data, cg::value<uint64_t> n) {
+        auto crc = cg::variable<uint32_t>("crc", 0xffffffff_u32);
+        auto idx = cg::variable<uint64_t>("idx", 0_u64);
+        cg::while_([&] { return idx.get() < n; },
+                   [&] {
+                     crc.set(cg::builtin::crc32c(crc.get(), cg::load(data + idx.get())));
+                     idx.set(idx.get() + 1_u64);
+                   });
+        cg::return_(crc.get() ^ 0xffffffff_u32);
+      });
+  auto module = std::move(builder).build();
+  auto crc32c_ptr = module.get_address(crc32c);
+
+  auto words = make_words(state.range(0));
+  for (auto _ : state) { benchmark::DoNotOptimize(crc32c_ptr(words.data(), words.size())); }
+  state.SetBytesProcessed(state.iterations() * words.size() * sizeof(uint64_t));
+}
+BENCHMARK(crc32c_codegen)->Range(8, 8 << 10);
+
+static void crc32c_cxx_table(benchmark::State& state) {
+  auto words = make_words(state.range(0));
+  for (auto _ : state) { benchmark::DoNotOptimize(crc32c_table_words(words.data(), words.size())); }
+  state.SetBytesProcessed(state.iterations() * words.size() * sizeof(uint64_t));
+}
+BENCHMARK(crc32c_cxx_table)->Range(8, 8 << 10);
+
+#if defined(__SSE4_2__)
+static void crc32c_cxx_sse42(benchmark::State& state) {
+  auto words = make_words(state.range(0));
+  for (auto _ : state) { benchmark::DoNotOptimize(crc32c_sse42_words(words.data(), words.size())); }
+  state.SetBytesProcessed(state.iterations() * words.size() * sizeof(uint64_t));
+}
+BENCHMARK(crc32c_cxx_sse42)->Range(8, 8 << 10);
+#endif
+
+static void hash_bytes_codegen(benchmark::State& state) {
+  auto comp = cg::compiler{};
+  auto builder = cg::module_builder(comp, "hash_bytes");
+  auto hash = builder.create_function<uint64_t(std::byte const*, uint64_t)>(
+      "hash", [](cg::value<std::byte const*> data, cg::value<uint64_t> n) {
+        auto h = cg::builtin::hasher{};
+        h.add_bytes(data, n);
+        cg::return_(h.get());
+      });
+  auto module = std::move(builder).build();
+  auto hash_ptr = module.get_address(hash);
+
+  auto words = make_words(state.range(0) / sizeof(uint64_t) + 1);
+  auto data = reinterpret_cast<std::byte const*>(words.data()) + 1;
+  for (auto _ : state) { benchmark::DoNotOptimize(hash_ptr(data, state.range(0))); }
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(hash_bytes_codegen)->Range(8, 64 << 10);
+
+static void hash_bytes_cxx(benchmark::State& state) {
+  auto words = make_words(state.range(0) / sizeof(uint64_t) + 1);
+  auto data = reinterpret_cast<std::byte const*>(words.data()) + 1;
+  for (auto _ : state) { benchmark::DoNotOptimize(hash_bytes(data, state.range(0))); }
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(hash_bytes_cxx)->Range(8, 64 << 10);
+
+static void hash_bytes_std_hash(benchmark::State& state) {
+  auto words = make_words(state.range(0) / sizeof(uint64_t) + 1);
+  auto data = std::string_view(reinterpret_cast<char const*>(words.data()) + 1, state.range(0));
+  for (auto _ : state) { benchmark::DoNotOptimize(std::hash<std::string_view>{}(data)); }
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(hash_bytes_std_hash)->Range(8, 64 << 10);
+
+static void hash_values_codegen(benchmark::State& state) {
+  auto comp = cg::compiler{};
+  auto builder = cg::module_builder(comp, "hash_values");
+  auto hash = builder.create_function<uint64_t(int32_t, int64_t, double)>(
+      "hash", [](cg::value<int32_t> a, cg::value<int64_t> b, cg::value<double> c) {
+        auto h = cg::builtin::hasher{};
+        h.add(a).add(b).add(c);
+        cg::return_(h.get());
+      });
+  auto module = std::move(builder).build();
+  auto hash_ptr = module.get_address(hash);
+
+  auto a = int32_t(1);
+  auto b = int64_t(2);
+  auto c = 3.0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(a);
+    benchmark::DoNotOptimize(hash_ptr(a, b, c));
+  }
+}
+BENCHMARK(hash_values_codegen);
+
+static void hash_values_cxx(benchmark::State& state) {
+  auto a = int32_t(1);
+  auto b = int64_t(2);
+  auto c = 3.0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(a);
+    auto c_bits = uint64_t{};
+    std::memcpy(&c_bits, &c, sizeof(c));
+    benchmark::DoNotOptimize(hash_combine(hash_combine(hash_combine(0, uint32_t(a)), b), c_bits));
+  }
+}
+BENCHMARK(hash_values_cxx);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,155 @@
+/*
+ * Copyright © 2019 Paweł Dziepak
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "codegen/interleave.hpp"
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "codegen/arithmetic_ops.hpp"
+#include "codegen/builtin.hpp"
+#include "codegen/compiler.hpp"
+#include "codegen/literals.hpp"
+#include "codegen/module.hpp"
+#include "codegen/module_builder.hpp"
+#include "codegen/relational_ops.hpp"
+#include "codegen/statements.hpp"
+#include "codegen/variable.hpp"
+
+namespace cg = codegen;
+using namespace cg::literals;
+
+namespace {
+
+constexpr auto table_size = size_t(1) << 22;
+constexpr auto probe_count = size_t(1) << 16;
+
+std::vector<uint64_t> make_keys(size_t n, uint64_t seed) {
+  auto keys = std::vector<uint64_t>(n);
+  auto state = seed;
+  for (auto& k : keys) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    k = state;
+  }
+  return keys;
+}
+
+uint64_t hash(uint64_t key) {
+  return (key * 0x9e3779b97f4a7c15) >> 32;
+}
+
+// A chained hash table much larger than the last level cache. Nodes are triples of key, value and index of the next
+// node in the chain, index 0 terminates the chain.
+struct hash_table {
+  std::vector<uint64_t> buckets;
+  std::vector<uint64_t> nodes;
+
+  explicit hash_table(std::vector<uint64_t> const& keys) : buckets(table_size), nodes{0, 0, 0} {
+    for (auto key : keys) {
+      auto& head = buckets[hash(key) & (table_size - 1)];
+      auto idx = nodes.size() / 3;
+      nodes.insert(nodes.end(), {key, key >> 32, head});
+      head = idx;
+    }
+  }
+};
+
+using probe_function = uint64_t(uint64_t const*, uint64_t const*, uint64_t const*, uint64_t);
+
+// Sums the values of the probe keys found in the table. group_size 0 emits the naive loop, which waits for each
+// lookup to complete before starting the next one.
+cg::function_ref<uint64_t, uint64_t const*, uint64_t const*, uint64_t const*, uint64_t>
+make_probe(cg::module_builder& builder, size_t group_size) {
+  return builder.create_function<probe_function>(
+      "probe", [&](cg::value<uint64_t const*> buckets, cg::value<uint64_t const*> nodes,
+                   cg::value<uint64_t const*> keys, cg::value<uint64_t> n) {
+        auto sum = cg::variable<uint64_t>("sum", 0_u64);
+        auto find_bucket = [&](cg::value<uint64_t> i) {
+          auto key = cg::load(keys + i);
+          return cg::let(buckets + ((key * 0x9e3779b97f4a7c15_u64 >> 32_u64) & cg::constant<uint64_t>(table_size - 1)));
+        };
+        auto walk_chain = [&](cg::value<uint64_t> i, cg::value<uint64_t> head) {
+          auto key = cg::let(cg::load(keys + i));
+          auto current = cg::variable<uint64_t>("current", head);
+          cg::while_([&] { return current.get() != 0_u64; },
+                     [&] {
+                       auto node = cg::let(nodes + current.get() * 3_u64);
+                       cg::if_(cg::load(node) == key, [&] { sum.set(sum.get() + cg::load(node + 1_u64)); });
+                       current.set(cg::load(node + 2_u64));
+                     });
+        };
+        if (!group_size) {
+          cg::for_(0_u64, n, 1_u64, [&](cg::value<uint64_t> i) { walk_chain(i, cg::let(cg::load(find_bucket(i)))); });
+        } else {
+          cg::interleaved_for_(
+              n, group_size,
+              [&](cg::value<uint64_t> i) {
+                auto bucket = find_bucket(i);
+                cg::builtin::prefetch(bucket);
+                return bucket;
+              },
+              [&](cg::value<uint64_t>, cg::value<uint64_t const*> bucket) {
+                auto head = cg::let(cg::load(bucket));
+                cg::builtin::prefetch(nodes + head * 3_u64);
+                return head;
+              },
+              walk_chain);
+        }
+        cg::return_(sum.get());
+      });
+}
+
+void hash_join_probe(benchmark::State& state, size_t group_size) {
+  auto build_keys = make_keys(table_size, 0x9e3779b97f4a7c15);
+  auto table = hash_table(build_keys);
+  // Half of the probe keys are present in the table.
+  auto probe_keys = make_keys(probe_count, 0xa0761d6478bd642f);
+  for (auto i = size_t(0); i < probe_count; i += 2) { probe_keys[i] = build_keys[probe_keys[i] % table_size]; }
+
+  auto comp = cg::compiler{};
+  auto builder = cg::module_builder(comp, "hash_join_probe");
+  auto probe = make_probe(builder, group_size);
+  auto module = std::move(builder).build();
+  auto probe_ptr = module.get_address(probe);
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(probe_ptr(table.buckets.data(), table.nodes.data(), probe_keys.data(), probe_count));
+  }
+  state.SetItemsProcessed(state.iterations() * probe_count);
+}
+
+} // namespace
+
+static void hash_join_probe_naive(benchmark::State& state) {
+  hash_join_probe(state, 0);
+}
+BENCHMARK(hash_join_probe_naive);
+
+static void hash_join_probe_interleaved(benchmark::State& state) {
+  hash_join_probe(state, state.range(0));
+}
+BENCHMARK(hash_join_probe_interleaved)->RangeMultiplier(2)->Range(1, 16);
+
+BENCHMARK_MAIN();
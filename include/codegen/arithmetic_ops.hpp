@@ -37,6 +37,8 @@ enum class arithmetic_operation_type {
   and_,
   or_,
   xor_,
+  shl,
+  shr,
 };
 
 template<arithmetic_operation_type Op, typename LHS, typename RHS> class arithmetic_operation {
@@ -45,25 +47,27 @@ template<arithmetic_operation_type Op, typename LHS, typename RHS> class arithme
 
   static_assert(std::is_same_v<typename LHS::value_type, typename RHS::value_type>);
 
+  using element_type = element_type_t<typename LHS::value_type>;
+
 public:
   using value_type = typename LHS::value_type;
 
   arithmetic_operation(LHS lhs, RHS rhs) : lhs_(std::move(lhs)), rhs_(std::move(rhs)) {}
 
   llvm::Value* eval() const {
-    if constexpr (std::is_integral_v<value_type>) {
+    if constexpr (std::is_integral_v<element_type>) {
       switch (Op) {
       case arithmetic_operation_type::add: return current_builder->ir_builder_.CreateAdd(lhs_.eval(), rhs_.eval());
       case arithmetic_operation_type::sub: return current_builder->ir_builder_.CreateSub(lhs_.eval(), rhs_.eval());
       case arithmetic_operation_type::mul: return current_builder->ir_builder_.CreateMul(lhs_.eval(), rhs_.eval());
       case arithmetic_operation_type::div:
-        if constexpr (std::is_signed_v<value_type>) {
+        if constexpr (std::is_signed_v<element_type>) {
           return current_builder->ir_builder_.CreateSDiv(lhs_.eval(), rhs_.eval());
         } else {
           return current_builder->ir_builder_.CreateUDiv(lhs_.eval(), rhs_.eval());
         }
       case arithmetic_operation_type::mod:
-        if constexpr (std::is_signed_v<value_type>) {
+        if constexpr (std::is_signed_v<element_type>) {
           return current_builder->ir_builder_.CreateSRem(lhs_.eval(), rhs_.eval());
         } else {
           return current_builder->ir_builder_.CreateURem(lhs_.eval(), rhs_.eval());
@@ -71,6 +75,13 @@ public:
       case arithmetic_operation_type::and_: return current_builder->ir_builder_.CreateAnd(lhs_.eval(), rhs_.eval());
       case arithmetic_operation_type::or_: return current_builder->ir_builder_.CreateOr(lhs_.eval(), rhs_.eval());
       case arithmetic_operation_type::xor_: return current_builder->ir_builder_.CreateXor(lhs_.eval(), rhs_.eval());
+      case arithmetic_operation_type::shl: return current_builder->ir_builder_.CreateShl(lhs_.eval(), rhs_.eval());
+      case arithmetic_operation_type::shr:
+        if constexpr (std::is_signed_v<element_type>) {
+          return current_builder->ir_builder_.CreateAShr(lhs_.eval(), rhs_.eval());
+        } else {
+          return current_builder->ir_builder_.CreateLShr(lhs_.eval(), rhs_.eval());
+        }
       }
     } else {
       switch (Op) {
@@ -81,7 +92,9 @@ public:
       case arithmetic_operation_type::mod: return current_builder->ir_builder_.CreateFRem(lhs_.eval(), rhs_.eval());
       case arithmetic_operation_type::and_: [[fallthrough]];
       case arithmetic_operation_type::or_: [[fallthrough]];
-      case arithmetic_operation_type::xor_: abort();
+      case arithmetic_operation_type::xor_: [[fallthrough]];
+      case arithmetic_operation_type::shl: [[fallthrough]];
+      case arithmetic_operation_type::shr: abort();
       }
     }
   }
@@ -89,20 +102,42 @@ public:
   friend std::ostream& operator<<(std::ostream& os, arithmetic_operation const& ao) {
     auto symbol = [] {
       switch (Op) {
-      case arithmetic_operation_type::add: return '+';
-      case arithmetic_operation_type::sub: return '-';
-      case arithmetic_operation_type::mul: return '*';
-      case arithmetic_operation_type::div: return '/';
-      case arithmetic_operation_type::mod: return '%';
-      case arithmetic_operation_type::and_: return '&';
-      case arithmetic_operation_type::or_: return '|';
-      case arithmetic_operation_type::xor_: return '^';
+      case arithmetic_operation_type::add: return "+";
+      case arithmetic_operation_type::sub: return "-";
+      case arithmetic_operation_type::mul: return "*";
+      case arithmetic_operation_type::div: return "/";
+      case arithmetic_operation_type::mod: return "%";
+      case arithmetic_operation_type::and_: return "&";
+      case arithmetic_operation_type::or_: return "|";
+      case arithmetic_operation_type::xor_: return "^";
+      case arithmetic_operation_type::shl: return "<<";
+      case arithmetic_operation_type::shr: return ">>";
       }
     }();
     return os << '(' << ao.lhs_ << ' ' << symbol << ' ' << ao.rhs_ << ')';
   }
 };
 
+template<typename Expression> class fast_math_impl {
+  fast_math_flags flags_;
+  Expression expr_;
+
+public:
+  using value_type = typename Expression::value_type;
+
+  fast_math_impl(fast_math_flags const& flags, Expression expr) : flags_(flags), expr_(std::move(expr)) {}
+
+  llvm::Value* eval() const {
+    auto guard = llvm::IRBuilderBase::FastMathFlagGuard(current_builder->ir_builder_);
+    current_builder->ir_builder_.setFastMathFlags(flags_.get());
+    return expr_.eval();
+  }
+
+  friend std::ostream& operator<<(std::ostream& os, fast_math_impl const& fmi) {
+    return os << "fast_math<" << fmi.flags_ << ">" << fmi.expr_;
+  }
+};
+
 enum class pointer_arithmetic_operation_type {
   add,
   sub,
@@ -154,42 +189,42 @@ public:
 } // namespace detail
 
 template<typename LHS, typename RHS,
-         typename = std::enable_if_t<std::is_arithmetic_v<typename RHS::value_type> &&
+         typename = std::enable_if_t<std::is_arithmetic_v<detail::element_type_t<typename RHS::value_type>> &&
                                      std::is_same_v<typename RHS::value_type, typename LHS::value_type>>>
 auto operator+(LHS lhs, RHS rhs) {
   return detail::arithmetic_operation<detail::arithmetic_operation_type::add, LHS, RHS>(std::move(lhs), std::move(rhs));
 }
 
 template<typename LHS, typename RHS,
-         typename = std::enable_if_t<std::is_arithmetic_v<typename RHS::value_type> &&
+         typename = std::enable_if_t<std::is_arithmetic_v<detail::element_type_t<typename RHS::value_type>> &&
                                      std::is_same_v<typename RHS::value_type, typename LHS::value_type>>>
 auto operator-(LHS lhs, RHS rhs) {
   return detail::arithmetic_operation<detail::arithmetic_operation_type::sub, LHS, RHS>(std::move(lhs), std::move(rhs));
 }
 
 template<typename LHS, typename RHS,
-         typename = std::enable_if_t<std::is_arithmetic_v<typename RHS::value_type> &&
+         typename = std::enable_if_t<std::is_arithmetic_v<detail::element_type_t<typename RHS::value_type>> &&
                                      std::is_same_v<typename RHS::value_type, typename LHS::value_type>>>
 auto operator*(LHS lhs, RHS rhs) {
   return detail::arithmetic_operation<detail::arithmetic_operation_type::mul, LHS, RHS>(std::move(lhs), std::move(rhs));
 }
 
 template<typename LHS, typename RHS,
-         typename = std::enable_if_t<std::is_arithmetic_v<typename RHS::value_type> &&
+         typename = std::enable_if_t<std::is_arithmetic_v<detail::element_type_t<typename RHS::value_type>> &&
                                      std::is_same_v<typename RHS::value_type, typename LHS::value_type>>>
 auto operator/(LHS lhs, RHS rhs) {
   return detail::arithmetic_operation<detail::arithmetic_operation_type::div, LHS, RHS>(std::move(lhs), std::move(rhs));
 }
 
 template<typename LHS, typename RHS,
-         typename = std::enable_if_t<std::is_arithmetic_v<typename RHS::value_type> &&
+         typename = std::enable_if_t<std::is_arithmetic_v<detail::element_type_t<typename RHS::value_type>> &&
                                      std::is_same_v<typename RHS::value_type, typename LHS::value_type>>>
 auto operator%(LHS lhs, RHS rhs) {
   return detail::arithmetic_operation<detail::arithmetic_operation_type::mod, LHS, RHS>(std::move(lhs), std::move(rhs));
 }
 
 template<typename LHS, typename RHS,
-         typename = std::enable_if_t<std::is_integral_v<typename RHS::value_type> &&
+         typename = std::enable_if_t<std::is_integral_v<detail::element_type_t<typename RHS::value_type>> &&
                                      std::is_same_v<typename RHS::value_type, typename LHS::value_type>>>
 auto operator&(LHS lhs, RHS rhs) {
   return detail::arithmetic_operation<detail::arithmetic_operation_type::and_, LHS, RHS>(std::move(lhs),
@@ -197,20 +232,45 @@ auto operator&(LHS lhs, RHS rhs) {
 }
 
 template<typename LHS, typename RHS,
-         typename = std::enable_if_t<std::is_integral_v<typename RHS::value_type> &&
+         typename = std::enable_if_t<std::is_integral_v<detail::element_type_t<typename RHS::value_type>> &&
                                      std::is_same_v<typename RHS::value_type, typename LHS::value_type>>>
 auto operator|(LHS lhs, RHS rhs) {
   return detail::arithmetic_operation<detail::arithmetic_operation_type::or_, LHS, RHS>(std::move(lhs), std::move(rhs));
 }
 
 template<typename LHS, typename RHS,
-         typename = std::enable_if_t<std::is_integral_v<typename RHS::value_type> &&
+         typename = std::enable_if_t<std::is_integral_v<detail::element_type_t<typename RHS::value_type>> &&
                                      std::is_same_v<typename RHS::value_type, typename LHS::value_type>>>
 auto operator^(LHS lhs, RHS rhs) {
   return detail::arithmetic_operation<detail::arithmetic_operation_type::xor_, LHS, RHS>(std::move(lhs),
                                                                                          std::move(rhs));
 }
 
+// The result of a shift by a number of bits greater than or equal to the width of the operand is undefined.
+template<typename LHS, typename RHS,
+         typename = std::enable_if_t<std::is_integral_v<detail::element_type_t<typename RHS::value_type>> &&
+                                     std::is_same_v<typename RHS::value_type, typename LHS::value_type>>>
+auto operator<<(LHS lhs, RHS rhs) {
+  return detail::arithmetic_operation<detail::arithmetic_operation_type::shl, LHS, RHS>(std::move(lhs),
+                                                                                        std::move(rhs));
+}
+
+// Evaluates the floating-point operations of the expression with the given fast-math flags, e.g.
+// fast_math(fast_math_flags{}.contract(), a * b + c) may be computed with a single FMA.
+template<typename Expression> auto fast_math(fast_math_flags const& flags, Expression expr) {
+  static_assert(std::is_floating_point_v<detail::element_type_t<typename Expression::value_type>>);
+  return detail::fast_math_impl<Expression>(flags, std::move(expr));
+}
+
+// Arithmetic shift for signed types, logical shift for unsigned ones.
+template<typename LHS, typename RHS,
+         typename = std::enable_if_t<std::is_integral_v<detail::element_type_t<typename RHS::value_type>> &&
+                                     std::is_same_v<typename RHS::value_type, typename LHS::value_type>>>
+auto operator>>(LHS lhs, RHS rhs) {
+  return detail::arithmetic_operation<detail::arithmetic_operation_type::shr, LHS, RHS>(std::move(lhs),
+                                                                                        std::move(rhs));
+}
+
 template<typename LHS, typename RHS,
          typename = std::enable_if_t<std::is_integral_v<typename RHS::value_type> &&
                                      std::is_pointer_v<typename LHS::value_type>>,
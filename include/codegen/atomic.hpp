@@ -0,0 +1,211 @@
+/*
+ * Copyright © 2019 Paweł Dziepak
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <stdexcept>
+
+#include <llvm/Support/AtomicOrdering.h>
+
+#include "codegen/module_builder.hpp"
+#include "codegen/utils.hpp"
+
+namespace codegen {
+
+enum class atomic_rmw_operation {
+  add,
+  sub,
+  and_,
+  or_,
+  xor_,
+  min,
+  max,
+  exchange,
+};
+
+template<typename Type> struct compare_exchange_result {
+  value<Type> previous;
+  value<bool> success;
+};
+
+namespace detail {
+
+inline llvm::AtomicOrdering get_atomic_ordering(std::memory_order order) {
+  switch (order) {
+  case std::memory_order_relaxed: return llvm::AtomicOrdering::Monotonic;
+  case std::memory_order_consume: [[fallthrough]];
+  case std::memory_order_acquire: return llvm::AtomicOrdering::Acquire;
+  case std::memory_order_release: return llvm::AtomicOrdering::Release;
+  case std::memory_order_acq_rel: return llvm::AtomicOrdering::AcquireRelease;
+  case std::memory_order_seq_cst: return llvm::AtomicOrdering::SequentiallyConsistent;
+  }
+  abort();
+}
+
+inline char const* get_memory_order_name(std::memory_order order) {
+  switch (order) {
+  case std::memory_order_relaxed: return "relaxed";
+  case std::memory_order_consume: return "consume";
+  case std::memory_order_acquire: return "acquire";
+  case std::memory_order_release: return "release";
+  case std::memory_order_acq_rel: return "acq_rel";
+  case std::memory_order_seq_cst: return "seq_cst";
+  }
+  abort();
+}
+
+inline char const* get_atomic_rmw_operation_name(atomic_rmw_operation op) {
+  switch (op) {
+  case atomic_rmw_operation::add: return "add";
+  case atomic_rmw_operation::sub: return "sub";
+  case atomic_rmw_operation::and_: return "and";
+  case atomic_rmw_operation::or_: return "or";
+  case atomic_rmw_operation::xor_: return "xor";
+  case atomic_rmw_operation::min: return "min";
+  case atomic_rmw_operation::max: return "max";
+  case atomic_rmw_operation::exchange: return "exchange";
+  }
+  abort();
+}
+
+// Orderings that LLVM rejects are reported before any IR is emitted, so that invalid code doesn't reach the verifier.
+inline void check_atomic_ordering(bool valid, char const* operation, std::memory_order order) {
+  if (!valid) {
+    throw std::invalid_argument(
+        fmt::format("memory order {} is not allowed for {}", get_memory_order_name(order), operation));
+  }
+}
+
+template<typename Pointer> using atomic_value_type = std::remove_pointer_t<typename Pointer::value_type>;
+
+} // namespace detail
+
+// Atomic accesses require the pointer to be naturally aligned. Loads can't be release or acq_rel and stores can't be
+// consume, acquire or acq_rel. Such orderings make the functions throw std::invalid_argument.
+
+template<typename Pointer, typename = std::enable_if_t<std::is_pointer_v<typename Pointer::value_type>>>
+auto atomic_load(Pointer ptr, std::memory_order order = std::memory_order_seq_cst) {
+  using value_type = std::remove_cv_t<detail::atomic_value_type<Pointer>>;
+  static_assert((std::is_integral_v<value_type> && !std::is_same_v<value_type, bool>) || std::is_pointer_v<value_type>);
+  detail::check_atomic_ordering(order != std::memory_order_release && order != std::memory_order_acq_rel,
+                                "atomic_load", order);
+  auto& mb = *detail::current_builder;
+
+  auto id = fmt::format("val{}", detail::id_counter++);
+
+  auto line_no =
+      mb.source_code_.add_line(fmt::format("{} = atomic_load({}, {});", id, ptr, detail::get_memory_order_name(order)));
+  mb.ir_builder_.SetCurrentDebugLocation(llvm::DebugLoc::get(line_no, 1, mb.dbg_scope_));
+  auto v = mb.ir_builder_.CreateAlignedLoad(ptr.eval(), sizeof(value_type));
+  v->setAtomic(detail::get_atomic_ordering(order));
+
+  auto dbg_value =
+      mb.dbg_builder_.createAutoVariable(mb.dbg_scope_, id, mb.dbg_file_, line_no, detail::type<value_type>::dbg());
+  mb.dbg_builder_.insertDbgValueIntrinsic(v, dbg_value, mb.dbg_builder_.createExpression(),
+                                          llvm::DebugLoc::get(line_no, 1, mb.dbg_scope_),
+                                          mb.ir_builder_.GetInsertBlock());
+
+  return value<value_type>{v, id};
+}
+
+template<typename Value, typename Pointer,
+         typename = std::enable_if_t<std::is_same_v<typename Value::value_type, detail::atomic_value_type<Pointer>>>>
+void atomic_store(Value v, Pointer ptr, std::memory_order order = std::memory_order_seq_cst) {
+  using value_type = detail::atomic_value_type<Pointer>;
+  static_assert((std::is_integral_v<value_type> && !std::is_same_v<value_type, bool>) || std::is_pointer_v<value_type>);
+  detail::check_atomic_ordering(order == std::memory_order_relaxed || order == std::memory_order_release ||
+                                    order == std::memory_order_seq_cst,
+                                "atomic_store", order);
+  auto& mb = *detail::current_builder;
+
+  auto line_no =
+      mb.source_code_.add_line(fmt::format("atomic_store({}, {}, {});", v, ptr, detail::get_memory_order_name(order)));
+  mb.ir_builder_.SetCurrentDebugLocation(llvm::DebugLoc::get(line_no, 1, mb.dbg_scope_));
+  auto store = mb.ir_builder_.CreateAlignedStore(v.eval(), ptr.eval(), sizeof(value_type));
+  store->setAtomic(detail::get_atomic_ordering(order));
+}
+
+// Atomically replaces the value pointed to by ptr with the result of the operation and returns the previous value.
+template<typename Pointer, typename Value,
+         typename = std::enable_if_t<std::is_same_v<typename Value::value_type, detail::atomic_value_type<Pointer>>>>
+auto atomic_rmw(atomic_rmw_operation op, Pointer ptr, Value v, std::memory_order order = std::memory_order_seq_cst) {
+  using value_type = detail::atomic_value_type<Pointer>;
+  static_assert(std::is_integral_v<value_type> && !std::is_same_v<value_type, bool>);
+  auto& mb = *detail::current_builder;
+
+  auto binop = [&] {
+    constexpr auto is_signed = std::is_signed_v<value_type>;
+    switch (op) {
+    case atomic_rmw_operation::add: return llvm::AtomicRMWInst::Add;
+    case atomic_rmw_operation::sub: return llvm::AtomicRMWInst::Sub;
+    case atomic_rmw_operation::and_: return llvm::AtomicRMWInst::And;
+    case atomic_rmw_operation::or_: return llvm::AtomicRMWInst::Or;
+    case atomic_rmw_operation::xor_: return llvm::AtomicRMWInst::Xor;
+    case atomic_rmw_operation::min: return is_signed ? llvm::AtomicRMWInst::Min : llvm::AtomicRMWInst::UMin;
+    case atomic_rmw_operation::max: return is_signed ? llvm::AtomicRMWInst::Max : llvm::AtomicRMWInst::UMax;
+    case atomic_rmw_operation::exchange: return llvm::AtomicRMWInst::Xchg;
+    }
+    abort();
+  }();
+
+  auto id = fmt::format("val{}", detail::id_counter++);
+  auto line_no =
+      mb.source_code_.add_line(fmt::format("{} = atomic_{}({}, {}, {});", id, detail::get_atomic_rmw_operation_name(op),
+                                           ptr, v, detail::get_memory_order_name(order)));
+  mb.ir_builder_.SetCurrentDebugLocation(llvm::DebugLoc::get(line_no, 1, mb.dbg_scope_));
+  auto ret = mb.ir_builder_.CreateAtomicRMW(binop, ptr.eval(), v.eval(), detail::get_atomic_ordering(order));
+  return value<value_type>{ret, id};
+}
+
+// Stores desired at ptr if it currently holds expected. The failure ordering cannot be release or acq_rel and cannot
+// be stronger than the success ordering, otherwise std::invalid_argument is thrown.
+template<typename Pointer, typename Expected, typename Desired,
+         typename = std::enable_if_t<
+             std::is_same_v<typename Expected::value_type, detail::atomic_value_type<Pointer>> &&
+             std::is_same_v<typename Desired::value_type, detail::atomic_value_type<Pointer>>>>
+auto cmpxchg(Pointer ptr, Expected expected, Desired desired, std::memory_order success = std::memory_order_seq_cst,
+             std::memory_order failure = std::memory_order_seq_cst) {
+  using value_type = detail::atomic_value_type<Pointer>;
+  static_assert((std::is_integral_v<value_type> && !std::is_same_v<value_type, bool>) || std::is_pointer_v<value_type>);
+  detail::check_atomic_ordering(failure != std::memory_order_release && failure != std::memory_order_acq_rel &&
+                                    !llvm::isStrongerThan(detail::get_atomic_ordering(failure),
+                                                          detail::get_atomic_ordering(success)),
+                                "the failure ordering of cmpxchg", failure);
+  auto& mb = *detail::current_builder;
+
+  auto id = fmt::format("val{}", detail::id_counter++);
+  auto line_no = mb.source_code_.add_line(fmt::format("{0}, {0}_success = cmpxchg({1}, {2}, {3}, {4}, {5});", id, ptr,
+                                                      expected, desired, detail::get_memory_order_name(success),
+                                                      detail::get_memory_order_name(failure)));
+  mb.ir_builder_.SetCurrentDebugLocation(llvm::DebugLoc::get(line_no, 1, mb.dbg_scope_));
+  auto ret = mb.ir_builder_.CreateAtomicCmpXchg(ptr.eval(), expected.eval(), desired.eval(),
+                                                detail::get_atomic_ordering(success),
+                                                detail::get_atomic_ordering(failure));
+  return compare_exchange_result<value_type>{value<value_type>{mb.ir_builder_.CreateExtractValue(ret, {0}), id},
+                                             value<bool>{mb.ir_builder_.CreateExtractValue(ret, {1}), id + "_success"}};
+}
+
+// A relaxed fence has no effect and is rejected with std::invalid_argument.
+void fence(std::memory_order order = std::memory_order_seq_cst);
+
+} // namespace codegen
@@ -23,6 +23,7 @@
 #pragma once
 
 #include "codegen/module_builder.hpp"
+#include "codegen/utils.hpp"
 
 namespace codegen::builtin {
 
@@ -58,6 +59,71 @@ template<typename Source1, typename Source2, typename Size> value<int> memcmp(So
   return value<int>{mb.ir_builder_.CreateCall(fn, {src1.eval(), src2.eval(), n.eval()}), "memcmp_ret"};
 }
 
+enum class prefetch_type {
+  read,
+  write,
+};
+
+// Locality ranges from 0 (no temporal locality, the data is not going to be reused) to 3 (high temporal locality,
+// the data should be kept in all levels of cache). It is a template parameter, since LLVM requires a constant.
+template<unsigned Locality = 3, typename Pointer> void prefetch(Pointer ptr, prefetch_type type = prefetch_type::read) {
+  static_assert(std::is_pointer_v<typename Pointer::value_type>);
+  static_assert(Locality <= 3, "locality ranges from 0 to 3");
+
+  auto& mb = *detail::current_builder;
+
+  auto line_no = mb.source_code_.add_line(
+      fmt::format("prefetch<{}>({}, {});", Locality, ptr, type == prefetch_type::read ? "read" : "write"));
+  mb.ir_builder_.SetCurrentDebugLocation(llvm::DebugLoc::get(line_no, 1, mb.dbg_scope_));
+
+  auto fn = llvm::Intrinsic::getDeclaration(mb.module_.get(), llvm::Intrinsic::prefetch);
+  auto address = mb.ir_builder_.CreatePointerCast(ptr.eval(), detail::type<std::byte*>::llvm());
+  mb.ir_builder_.CreateCall(fn, {address, mb.ir_builder_.getInt32(type == prefetch_type::write),
+                                 mb.ir_builder_.getInt32(Locality), mb.ir_builder_.getInt32(1)});
+}
+
+namespace detail {
+
+inline llvm::MDNode* get_nontemporal_metadata() {
+  auto& mb = *codegen::detail::current_builder;
+  return llvm::MDNode::get(*mb.context_, {llvm::ConstantAsMetadata::get(mb.ir_builder_.getInt32(1))});
+}
+
+} // namespace detail
+
+// Non-temporal accesses hint that the data is not going to be reused and should bypass the cache hierarchy if possible.
+// Non-temporal stores of vectors typically require the pointer to be aligned to the size of the vector.
+
+template<typename Pointer> auto nontemporal_load(Pointer ptr) {
+  static_assert(std::is_pointer_v<typename Pointer::value_type>);
+  using value_type = std::remove_cv_t<std::remove_pointer_t<typename Pointer::value_type>>;
+
+  auto& mb = *codegen::detail::current_builder;
+
+  auto id = fmt::format("val{}", codegen::detail::id_counter++);
+  auto line_no = mb.source_code_.add_line(fmt::format("{} = nontemporal_load({});", id, ptr));
+  mb.ir_builder_.SetCurrentDebugLocation(llvm::DebugLoc::get(line_no, 1, mb.dbg_scope_));
+  auto v = mb.ir_builder_.CreateAlignedLoad(ptr.eval(), codegen::detail::type<value_type>::alignment);
+  v->setMetadata(llvm::LLVMContext::MD_nontemporal, detail::get_nontemporal_metadata());
+  v->setMetadata(llvm::LLVMContext::MD_tbaa, codegen::detail::get_tbaa_access_tag<value_type>());
+  return value<value_type>{v, id};
+}
+
+template<typename Value, typename Pointer> void nontemporal_store(Value v, Pointer ptr) {
+  static_assert(std::is_pointer_v<typename Pointer::value_type>);
+  using value_type = std::remove_pointer_t<typename Pointer::value_type>;
+  static_assert(!std::is_const_v<value_type>);
+  static_assert(std::is_same_v<typename Value::value_type, value_type>);
+
+  auto& mb = *codegen::detail::current_builder;
+
+  auto line_no = mb.source_code_.add_line(fmt::format("nontemporal_store({}, {});", v, ptr));
+  mb.ir_builder_.SetCurrentDebugLocation(llvm::DebugLoc::get(line_no, 1, mb.dbg_scope_));
+  auto store = mb.ir_builder_.CreateAlignedStore(v.eval(), ptr.eval(), codegen::detail::type<value_type>::alignment);
+  store->setMetadata(llvm::LLVMContext::MD_nontemporal, detail::get_nontemporal_metadata());
+  store->setMetadata(llvm::LLVMContext::MD_tbaa, codegen::detail::get_tbaa_access_tag<value_type>());
+}
+
 namespace detail {
 
 template<typename Value> class bswap_impl {
@@ -69,17 +135,419 @@ public:
 
   explicit bswap_impl(Value v) : value_(v) {}
 
-  llvm::Value* eval() {
+  llvm::Value* eval() const {
     return codegen::detail::current_builder->ir_builder_.CreateUnaryIntrinsic(llvm::Intrinsic::bswap, value_.eval());
   }
 
   friend std::ostream& operator<<(std::ostream& os, bswap_impl bi) { return os << "bswap(" << bi.value_ << ")"; }
 };
 
+enum class bit_operation_type {
+  popcount,
+  ctlz,
+  cttz,
+  bitreverse,
+};
+
+template<bit_operation_type Op, typename Value> class bit_operation_impl {
+  Value value_;
+
+public:
+  using value_type = typename Value::value_type;
+  static_assert(std::is_integral_v<codegen::detail::element_type_t<value_type>>);
+
+  explicit bit_operation_impl(Value v) : value_(v) {}
+
+  llvm::Value* eval() const {
+    auto& mb = *codegen::detail::current_builder;
+    switch (Op) {
+    case bit_operation_type::popcount:
+      return mb.ir_builder_.CreateUnaryIntrinsic(llvm::Intrinsic::ctpop, value_.eval());
+    case bit_operation_type::ctlz:
+      return mb.ir_builder_.CreateBinaryIntrinsic(llvm::Intrinsic::ctlz, value_.eval(), mb.ir_builder_.getFalse());
+    case bit_operation_type::cttz:
+      return mb.ir_builder_.CreateBinaryIntrinsic(llvm::Intrinsic::cttz, value_.eval(), mb.ir_builder_.getFalse());
+    case bit_operation_type::bitreverse:
+      return mb.ir_builder_.CreateUnaryIntrinsic(llvm::Intrinsic::bitreverse, value_.eval());
+    }
+    abort();
+  }
+
+  friend std::ostream& operator<<(std::ostream& os, bit_operation_impl boi) {
+    auto name = [] {
+      switch (Op) {
+      case bit_operation_type::popcount: return "popcount";
+      case bit_operation_type::ctlz: return "ctlz";
+      case bit_operation_type::cttz: return "cttz";
+      case bit_operation_type::bitreverse: return "bitreverse";
+      }
+    }();
+    return os << name << "(" << boi.value_ << ")";
+  }
+};
+
+enum class rotate_direction {
+  left,
+  right,
+};
+
+template<rotate_direction Direction, typename Value, typename Amount> class rotate_impl {
+  Value value_;
+  Amount amount_;
+
+public:
+  using value_type = typename Value::value_type;
+  static_assert(std::is_integral_v<codegen::detail::element_type_t<value_type>>);
+  static_assert(std::is_same_v<value_type, typename Amount::value_type>);
+
+  rotate_impl(Value v, Amount n) : value_(v), amount_(n) {}
+
+  llvm::Value* eval() const {
+    auto& mb = *codegen::detail::current_builder;
+    auto id = Direction == rotate_direction::left ? llvm::Intrinsic::fshl : llvm::Intrinsic::fshr;
+    auto fn = llvm::Intrinsic::getDeclaration(mb.module_.get(), id, {codegen::detail::type<value_type>::llvm()});
+    auto v = value_.eval();
+    return mb.ir_builder_.CreateCall(fn, {v, v, amount_.eval()});
+  }
+
+  friend std::ostream& operator<<(std::ostream& os, rotate_impl ri) {
+    return os << (Direction == rotate_direction::left ? "rotl(" : "rotr(") << ri.value_ << ", " << ri.amount_ << ")";
+  }
+};
+
+enum class bit_deposit_type {
+  deposit,
+  extract,
+};
+
+template<bit_deposit_type Op, typename Value, typename Mask> class bit_deposit_impl {
+  Value value_;
+  Mask mask_;
+
+public:
+  using value_type = typename Value::value_type;
+  static_assert(std::is_same_v<value_type, uint32_t> || std::is_same_v<value_type, uint64_t>);
+  static_assert(std::is_same_v<value_type, typename Mask::value_type>);
+
+  bit_deposit_impl(Value v, Mask m) : value_(v), mask_(m) {}
+
+  llvm::Value* eval() const {
+    auto& mb = *codegen::detail::current_builder;
+    if (mb.target_has_feature("bmi2")) {
+      auto id = [] {
+        if constexpr (sizeof(value_type) == sizeof(uint32_t)) {
+          return Op == bit_deposit_type::deposit ? llvm::Intrinsic::x86_bmi_pdep_32 : llvm::Intrinsic::x86_bmi_pext_32;
+        } else {
+          return Op == bit_deposit_type::deposit ? llvm::Intrinsic::x86_bmi_pdep_64 : llvm::Intrinsic::x86_bmi_pext_64;
+        }
+      }();
+      auto fn = llvm::Intrinsic::getDeclaration(mb.module_.get(), id);
+      return mb.ir_builder_.CreateCall(fn, {value_.eval(), mask_.eval()});
+    }
+    return emulate();
+  }
+
+  friend std::ostream& operator<<(std::ostream& os, bit_deposit_impl bdi) {
+    return os << (Op == bit_deposit_type::deposit ? "pdep(" : "pext(") << bdi.value_ << ", " << bdi.mask_ << ")";
+  }
+
+private:
+  // Visits the set bits of the mask one at a time, pairing each of them with the consecutive low-order bits of the
+  // result (extract) or of the source value (deposit).
+  llvm::Value* emulate() const {
+    auto& mb = *codegen::detail::current_builder;
+    auto& irb = mb.ir_builder_;
+    auto int_type = codegen::detail::type<value_type>::llvm();
+    auto zero = llvm::ConstantInt::get(int_type, 0);
+    auto one = llvm::ConstantInt::get(int_type, 1);
+
+    auto value = value_.eval();
+    auto mask = mask_.eval();
+
+    auto entry_block = irb.GetInsertBlock();
+    auto loop_block = llvm::BasicBlock::Create(*mb.context_, "bit_deposit_loop", mb.function_);
+    auto body_block = llvm::BasicBlock::Create(*mb.context_, "bit_deposit_body", mb.function_);
+    auto end_block = llvm::BasicBlock::Create(*mb.context_, "bit_deposit_end", mb.function_);
+    irb.CreateBr(loop_block);
+
+    irb.SetInsertPoint(loop_block);
+    auto remaining = irb.CreatePHI(int_type, 2);
+    auto position = irb.CreatePHI(int_type, 2);
+    auto result = irb.CreatePHI(int_type, 2);
+    remaining->addIncoming(mask, entry_block);
+    position->addIncoming(one, entry_block);
+    result->addIncoming(zero, entry_block);
+    irb.CreateCondBr(irb.CreateICmpNE(remaining, zero), body_block, end_block);
+
+    irb.SetInsertPoint(body_block);
+    auto lowest = irb.CreateAnd(remaining, irb.CreateNeg(remaining));
+    auto source_bit = Op == bit_deposit_type::deposit ? position : lowest;
+    auto target_bit = Op == bit_deposit_type::deposit ? lowest : position;
+    auto is_set = irb.CreateICmpNE(irb.CreateAnd(value, source_bit), zero);
+    result->addIncoming(irb.CreateOr(result, irb.CreateSelect(is_set, target_bit, zero)), body_block);
+    remaining->addIncoming(irb.CreateXor(remaining, lowest), body_block);
+    position->addIncoming(irb.CreateShl(position, one), body_block);
+    irb.CreateBr(loop_block);
+
+    irb.SetInsertPoint(end_block);
+    return result;
+  }
+};
+
+enum class minmax_operation_type {
+  min,
+  max,
+};
+
+template<minmax_operation_type Op, typename LHS, typename RHS> class minmax_impl {
+  LHS lhs_;
+  RHS rhs_;
+
+  using element_type = codegen::detail::element_type_t<typename LHS::value_type>;
+
+public:
+  using value_type = typename LHS::value_type;
+  static_assert(std::is_arithmetic_v<element_type>);
+  static_assert(std::is_same_v<value_type, typename RHS::value_type>);
+
+  minmax_impl(LHS lhs, RHS rhs) : lhs_(lhs), rhs_(rhs) {}
+
+  llvm::Value* eval() const {
+    auto& mb = *codegen::detail::current_builder;
+    auto lhs = lhs_.eval();
+    auto rhs = rhs_.eval();
+    if constexpr (std::is_floating_point_v<element_type>) {
+      auto id = Op == minmax_operation_type::min ? llvm::Intrinsic::minnum : llvm::Intrinsic::maxnum;
+      return mb.ir_builder_.CreateBinaryIntrinsic(id, lhs, rhs);
+    } else {
+      auto less = std::is_signed_v<element_type> ? mb.ir_builder_.CreateICmpSLT(lhs, rhs)
+                                                 : mb.ir_builder_.CreateICmpULT(lhs, rhs);
+      return Op == minmax_operation_type::min ? mb.ir_builder_.CreateSelect(less, lhs, rhs)
+                                              : mb.ir_builder_.CreateSelect(less, rhs, lhs);
+    }
+  }
+
+  friend std::ostream& operator<<(std::ostream& os, minmax_impl mi) {
+    return os << (Op == minmax_operation_type::min ? "min(" : "max(") << mi.lhs_ << ", " << mi.rhs_ << ")";
+  }
+};
+
+template<typename Value> class abs_impl {
+  Value value_;
+
+  using element_type = codegen::detail::element_type_t<typename Value::value_type>;
+
+public:
+  using value_type = typename Value::value_type;
+  static_assert(std::is_signed_v<element_type>);
+
+  explicit abs_impl(Value v) : value_(v) {}
+
+  llvm::Value* eval() const {
+    auto& mb = *codegen::detail::current_builder;
+    auto v = value_.eval();
+    if constexpr (std::is_floating_point_v<element_type>) {
+      return mb.ir_builder_.CreateUnaryIntrinsic(llvm::Intrinsic::fabs, v);
+    } else {
+      auto is_negative = mb.ir_builder_.CreateICmpSLT(v, llvm::Constant::getNullValue(v->getType()));
+      return mb.ir_builder_.CreateSelect(is_negative, mb.ir_builder_.CreateNeg(v), v);
+    }
+  }
+
+  friend std::ostream& operator<<(std::ostream& os, abs_impl ai) { return os << "abs(" << ai.value_ << ")"; }
+};
+
+enum class fp_function_type {
+  sqrt,
+  floor,
+  ceil,
+};
+
+template<fp_function_type Op, typename Value> class fp_function_impl {
+  Value value_;
+
+public:
+  using value_type = typename Value::value_type;
+  static_assert(std::is_floating_point_v<codegen::detail::element_type_t<value_type>>);
+
+  explicit fp_function_impl(Value v) : value_(v) {}
+
+  llvm::Value* eval() const {
+    auto& mb = *codegen::detail::current_builder;
+    auto id = [] {
+      switch (Op) {
+      case fp_function_type::sqrt: return llvm::Intrinsic::sqrt;
+      case fp_function_type::floor: return llvm::Intrinsic::floor;
+      case fp_function_type::ceil: return llvm::Intrinsic::ceil;
+      }
+      abort();
+    }();
+    return mb.ir_builder_.CreateUnaryIntrinsic(id, value_.eval());
+  }
+
+  friend std::ostream& operator<<(std::ostream& os, fp_function_impl ffi) {
+    auto name = [] {
+      switch (Op) {
+      case fp_function_type::sqrt: return "sqrt";
+      case fp_function_type::floor: return "floor";
+      case fp_function_type::ceil: return "ceil";
+      }
+    }();
+    return os << name << "(" << ffi.value_ << ")";
+  }
+};
+
+template<typename Magnitude, typename Sign> class copysign_impl {
+  Magnitude magnitude_;
+  Sign sign_;
+
+public:
+  using value_type = typename Magnitude::value_type;
+  static_assert(std::is_floating_point_v<codegen::detail::element_type_t<value_type>>);
+  static_assert(std::is_same_v<value_type, typename Sign::value_type>);
+
+  copysign_impl(Magnitude mag, Sign sgn) : magnitude_(mag), sign_(sgn) {}
+
+  llvm::Value* eval() const {
+    return codegen::detail::current_builder->ir_builder_.CreateBinaryIntrinsic(llvm::Intrinsic::copysign,
+                                                                               magnitude_.eval(), sign_.eval());
+  }
+
+  friend std::ostream& operator<<(std::ostream& os, copysign_impl ci) {
+    return os << "copysign(" << ci.magnitude_ << ", " << ci.sign_ << ")";
+  }
+};
+
+template<typename A, typename B, typename C> class fma_impl {
+  A a_;
+  B b_;
+  C c_;
+
+public:
+  using value_type = typename A::value_type;
+  static_assert(std::is_floating_point_v<codegen::detail::element_type_t<value_type>>);
+  static_assert(std::is_same_v<value_type, typename B::value_type>);
+  static_assert(std::is_same_v<value_type, typename C::value_type>);
+
+  fma_impl(A a, B b, C c) : a_(a), b_(b), c_(c) {}
+
+  llvm::Value* eval() const {
+    auto& mb = *codegen::detail::current_builder;
+    auto fn = llvm::Intrinsic::getDeclaration(mb.module_.get(), llvm::Intrinsic::fma,
+                                              {codegen::detail::type<value_type>::llvm()});
+    return mb.ir_builder_.CreateCall(fn, {a_.eval(), b_.eval(), c_.eval()});
+  }
+
+  friend std::ostream& operator<<(std::ostream& os, fma_impl fi) {
+    return os << "fma(" << fi.a_ << ", " << fi.b_ << ", " << fi.c_ << ")";
+  }
+};
+
+template<typename LHS, typename RHS> class mulh_impl {
+  LHS lhs_;
+  RHS rhs_;
+
+public:
+  using value_type = typename LHS::value_type;
+  static_assert(std::is_same_v<value_type, int64_t> || std::is_same_v<value_type, uint64_t>);
+  static_assert(std::is_same_v<value_type, typename RHS::value_type>);
+
+  mulh_impl(LHS lhs, RHS rhs) : lhs_(lhs), rhs_(rhs) {}
+
+  llvm::Value* eval() const {
+    auto& irb = codegen::detail::current_builder->ir_builder_;
+    auto wide_type = codegen::detail::type<__int128>::llvm();
+    auto extend = [&](llvm::Value* v) {
+      return std::is_signed_v<value_type> ? irb.CreateSExt(v, wide_type) : irb.CreateZExt(v, wide_type);
+    };
+    auto product = irb.CreateMul(extend(lhs_.eval()), extend(rhs_.eval()));
+    return irb.CreateTrunc(irb.CreateLShr(product, 64), codegen::detail::type<value_type>::llvm());
+  }
+
+  friend std::ostream& operator<<(std::ostream& os, mulh_impl mi) {
+    return os << "mulh(" << mi.lhs_ << ", " << mi.rhs_ << ")";
+  }
+};
+
 } // namespace detail
 
 template<typename Value> auto bswap(Value v) {
   return detail::bswap_impl<Value>(v);
 }
 
+template<typename Value> auto popcount(Value v) {
+  return detail::bit_operation_impl<detail::bit_operation_type::popcount, Value>(v);
+}
+
+// Count leading and trailing zeros, respectively. Both return the width of the type if the argument is zero.
+template<typename Value> auto ctlz(Value v) {
+  return detail::bit_operation_impl<detail::bit_operation_type::ctlz, Value>(v);
+}
+
+template<typename Value> auto cttz(Value v) {
+  return detail::bit_operation_impl<detail::bit_operation_type::cttz, Value>(v);
+}
+
+template<typename Value> auto bitreverse(Value v) {
+  return detail::bit_operation_impl<detail::bit_operation_type::bitreverse, Value>(v);
+}
+
+// The rotation amount is taken modulo the width of the type.
+template<typename Value, typename Amount> auto rotl(Value v, Amount n) {
+  return detail::rotate_impl<detail::rotate_direction::left, Value, Amount>(v, n);
+}
+
+template<typename Value, typename Amount> auto rotr(Value v, Amount n) {
+  return detail::rotate_impl<detail::rotate_direction::right, Value, Amount>(v, n);
+}
+
+// Parallel bit deposit and extract. Lowered to BMI2 instructions if the host supports them and emulated with a loop
+// over the set bits of the mask otherwise.
+template<typename Value, typename Mask> auto pdep(Value v, Mask m) {
+  return detail::bit_deposit_impl<detail::bit_deposit_type::deposit, Value, Mask>(v, m);
+}
+
+template<typename Value, typename Mask> auto pext(Value v, Mask m) {
+  return detail::bit_deposit_impl<detail::bit_deposit_type::extract, Value, Mask>(v, m);
+}
+
+// Returns the high 64 bits of the 128-bit product of two 64-bit integers.
+template<typename LHS, typename RHS> auto mulh(LHS lhs, RHS rhs) {
+  return detail::mulh_impl<LHS, RHS>(lhs, rhs);
+}
+
+// Floating-point min and max return the other operand if one of them is NaN.
+template<typename LHS, typename RHS> auto min(LHS lhs, RHS rhs) {
+  return detail::minmax_impl<detail::minmax_operation_type::min, LHS, RHS>(lhs, rhs);
+}
+
+template<typename LHS, typename RHS> auto max(LHS lhs, RHS rhs) {
+  return detail::minmax_impl<detail::minmax_operation_type::max, LHS, RHS>(lhs, rhs);
+}
+
+template<typename Value> auto abs(Value v) {
+  return detail::abs_impl<Value>(v);
+}
+
+template<typename Value> auto sqrt(Value v) {
+  return detail::fp_function_impl<detail::fp_function_type::sqrt, Value>(v);
+}
+
+template<typename Value> auto floor(Value v) {
+  return detail::fp_function_impl<detail::fp_function_type::floor, Value>(v);
+}
+
+template<typename Value> auto ceil(Value v) {
+  return detail::fp_function_impl<detail::fp_function_type::ceil, Value>(v);
+}
+
+template<typename Magnitude, typename Sign> auto copysign(Magnitude mag, Sign sgn) {
+  return detail::copysign_impl<Magnitude, Sign>(mag, sgn);
+}
+
+// Computes a * b + c with a single rounding.
+template<typename A, typename B, typename C> auto fma(A a, B b, C c) {
+  return detail::fma_impl<A, B, C>(a, b, c);
+}
+
 } // namespace codegen::builtin
@@ -0,0 +1,214 @@
+/*
+ * Copyright © 2019 Paweł Dziepak
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <llvm/IR/MDBuilder.h>
+
+#include "codegen/module_builder.hpp"
+#include "codegen/statements.hpp"
+#include "codegen/utils.hpp"
+
+namespace codegen {
+
+template<typename Type> struct checked_value {
+  value<Type> result;
+  value<bool> overflow;
+};
+
+namespace detail {
+
+enum class checked_operation_type {
+  add,
+  sub,
+  mul,
+};
+
+template<checked_operation_type Op, typename LHS, typename RHS> auto checked_operation(LHS lhs, RHS rhs) {
+  using value_type = typename LHS::value_type;
+  static_assert(std::is_integral_v<value_type> && !std::is_same_v<value_type, bool>);
+  static_assert(std::is_same_v<value_type, typename RHS::value_type>);
+
+  auto& mb = *current_builder;
+
+  auto [intrinsic, name] = [] {
+    constexpr auto is_signed = std::is_signed_v<value_type>;
+    switch (Op) {
+    case checked_operation_type::add:
+      return std::pair(is_signed ? llvm::Intrinsic::sadd_with_overflow : llvm::Intrinsic::uadd_with_overflow,
+                       "checked_add");
+    case checked_operation_type::sub:
+      return std::pair(is_signed ? llvm::Intrinsic::ssub_with_overflow : llvm::Intrinsic::usub_with_overflow,
+                       "checked_sub");
+    case checked_operation_type::mul:
+      return std::pair(is_signed ? llvm::Intrinsic::smul_with_overflow : llvm::Intrinsic::umul_with_overflow,
+                       "checked_mul");
+    }
+    abort();
+  }();
+
+  auto id = fmt::format("val{}", id_counter++);
+  auto line_no = mb.source_code_.add_line(fmt::format("{0}, {0}_overflow = {1}({2}, {3});", id, name, lhs, rhs));
+  mb.ir_builder_.SetCurrentDebugLocation(llvm::DebugLoc::get(line_no, 1, mb.dbg_scope_));
+
+  auto fn = llvm::Intrinsic::getDeclaration(mb.module_.get(), intrinsic, {type<value_type>::llvm()});
+  auto ret = mb.ir_builder_.CreateCall(fn, {lhs.eval(), rhs.eval()});
+  return checked_value<value_type>{value<value_type>{mb.ir_builder_.CreateExtractValue(ret, {0}), id},
+                                   value<bool>{mb.ir_builder_.CreateExtractValue(ret, {1}), id + "_overflow"}};
+}
+
+// The handler is generated inline, so that it can exit the function or the enclosing loop. Branch weights are the
+// only hint that it is cold, the block placement moves it away from the fall-through path.
+template<typename Type, typename OverflowHandler>
+value<Type> handle_overflow(checked_value<Type> const& cv, OverflowHandler&& handler) {
+  auto& mb = *current_builder;
+  auto unlikely = llvm::MDBuilder(*mb.context_).createBranchWeights(1, 2000);
+  if_impl(cv.overflow, std::forward<OverflowHandler>(handler), unlikely);
+  return cv.result;
+}
+
+enum class saturating_operation_type {
+  add,
+  sub,
+};
+
+template<saturating_operation_type Op, typename LHS, typename RHS> class saturating_operation {
+  LHS lhs_;
+  RHS rhs_;
+
+  using element_type = element_type_t<typename LHS::value_type>;
+
+  static_assert(std::is_integral_v<element_type> && !std::is_same_v<element_type, bool>);
+  static_assert(std::is_same_v<typename LHS::value_type, typename RHS::value_type>);
+
+public:
+  using value_type = typename LHS::value_type;
+
+  saturating_operation(LHS lhs, RHS rhs) : lhs_(std::move(lhs)), rhs_(std::move(rhs)) {}
+
+  llvm::Value* eval() const {
+    auto intrinsic = [] {
+      switch (Op) {
+      case saturating_operation_type::add:
+        return std::is_signed_v<element_type> ? llvm::Intrinsic::sadd_sat : llvm::Intrinsic::uadd_sat;
+      case saturating_operation_type::sub:
+        return std::is_signed_v<element_type> ? llvm::Intrinsic::ssub_sat : llvm::Intrinsic::usub_sat;
+      }
+      abort();
+    }();
+    return current_builder->ir_builder_.CreateBinaryIntrinsic(intrinsic, lhs_.eval(), rhs_.eval());
+  }
+
+  friend std::ostream& operator<<(std::ostream& os, saturating_operation const& so) {
+    auto name = [] {
+      switch (Op) {
+      case saturating_operation_type::add: return "saturating_add";
+      case saturating_operation_type::sub: return "saturating_sub";
+      }
+    }();
+    return os << name << '(' << so.lhs_ << ", " << so.rhs_ << ')';
+  }
+};
+
+} // namespace detail
+
+// Checked arithmetic produces the wrapped result together with a flag set if the operation has overflowed. The variants
+// accepting an overflow handler branch to it if an overflow occurred. The handler is placed on a cold path and
+// typically leaves the function, otherwise the execution continues with the wrapped result.
+
+template<typename LHS, typename RHS> auto checked_add(LHS lhs, RHS rhs) {
+  return detail::checked_operation<detail::checked_operation_type::add>(std::move(lhs), std::move(rhs));
+}
+
+template<typename LHS, typename RHS, typename OverflowHandler>
+auto checked_add(LHS lhs, RHS rhs, OverflowHandler&& handler) {
+  return detail::handle_overflow(checked_add(std::move(lhs), std::move(rhs)),
+                                 std::forward<OverflowHandler>(handler));
+}
+
+template<typename LHS, typename RHS> auto checked_sub(LHS lhs, RHS rhs) {
+  return detail::checked_operation<detail::checked_operation_type::sub>(std::move(lhs), std::move(rhs));
+}
+
+template<typename LHS, typename RHS, typename OverflowHandler>
+auto checked_sub(LHS lhs, RHS rhs, OverflowHandler&& handler) {
+  return detail::handle_overflow(checked_sub(std::move(lhs), std::move(rhs)),
+                                 std::forward<OverflowHandler>(handler));
+}
+
+template<typename LHS, typename RHS, typename = std::enable_if_t<std::is_integral_v<typename LHS::value_type>>>
+auto checked_mul(LHS lhs, RHS rhs) {
+  return detail::checked_operation<detail::checked_operation_type::mul>(std::move(lhs), std::move(rhs));
+}
+
+template<typename LHS, typename RHS, typename OverflowHandler>
+auto checked_mul(LHS lhs, RHS rhs, OverflowHandler&& handler) {
+  return detail::handle_overflow(checked_mul(std::move(lhs), std::move(rhs)),
+                                 std::forward<OverflowHandler>(handler));
+}
+
+// Integer conversion that reports whether the value is representable in the target type.
+template<typename ToType, typename Value> checked_value<ToType> checked_cast(Value v) {
+  using from_type = typename Value::value_type;
+  static_assert(std::is_integral_v<from_type> && !std::is_same_v<from_type, bool>);
+  static_assert(std::is_integral_v<ToType> && !std::is_same_v<ToType, bool>);
+
+  auto& mb = *detail::current_builder;
+  auto& irb = mb.ir_builder_;
+
+  auto id = fmt::format("val{}", detail::id_counter++);
+  auto line_no = mb.source_code_.add_line(
+      fmt::format("{0}, {0}_overflow = checked_cast<{1}>({2});", id, detail::type<ToType>::name(), v));
+  irb.SetCurrentDebugLocation(llvm::DebugLoc::get(line_no, 1, mb.dbg_scope_));
+
+  auto source = v.eval();
+  auto result = std::is_signed_v<from_type> ? irb.CreateSExtOrTrunc(source, detail::type<ToType>::llvm())
+                                            : irb.CreateZExtOrTrunc(source, detail::type<ToType>::llvm());
+  auto round_trip = std::is_signed_v<ToType> ? irb.CreateSExtOrTrunc(result, detail::type<from_type>::llvm())
+                                             : irb.CreateZExtOrTrunc(result, detail::type<from_type>::llvm());
+  auto overflow = irb.CreateICmpNE(round_trip, source);
+  if constexpr (std::is_signed_v<from_type> && !std::is_signed_v<ToType>) {
+    overflow = irb.CreateOr(overflow, irb.CreateICmpSLT(source, llvm::Constant::getNullValue(source->getType())));
+  } else if constexpr (!std::is_signed_v<from_type> && std::is_signed_v<ToType>) {
+    overflow = irb.CreateOr(overflow, irb.CreateICmpSLT(result, llvm::Constant::getNullValue(result->getType())));
+  }
+  return checked_value<ToType>{value<ToType>{result, id}, value<bool>{overflow, id + "_overflow"}};
+}
+
+template<typename ToType, typename Value, typename OverflowHandler>
+value<ToType> checked_cast(Value v, OverflowHandler&& handler) {
+  return detail::handle_overflow(checked_cast<ToType>(std::move(v)), std::forward<OverflowHandler>(handler));
+}
+
+// Saturating arithmetic clamps the result to the range of the type.
+
+template<typename LHS, typename RHS> auto saturating_add(LHS lhs, RHS rhs) {
+  return detail::saturating_operation<detail::saturating_operation_type::add, LHS, RHS>(std::move(lhs),
+                                                                                        std::move(rhs));
+}
+
+template<typename LHS, typename RHS> auto saturating_sub(LHS lhs, RHS rhs) {
+  return detail::saturating_operation<detail::saturating_operation_type::sub, LHS, RHS>(std::move(lhs),
+                                                                                        std::move(rhs));
+}
+
+} // namespace codegen
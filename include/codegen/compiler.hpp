@@ -23,7 +23,9 @@
 #pragma once
 
 #include <filesystem>
+#include <functional>
 #include <unordered_map>
+#include <vector>
 
 #include <llvm/ExecutionEngine/JITEventListener.h>
 
@@ -34,6 +36,8 @@
 #include <llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h>
 #include <llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h>
 
+#include <llvm/Support/MemoryBuffer.h>
+
 #include "utils.hpp"
 
 namespace codegen {
@@ -52,20 +56,32 @@ class compiler {
 
   llvm::JITEventListener* gdb_listener_;
 
+  std::function<void(std::string const&)> optimized_ir_handler_;
+
   std::filesystem::path source_directory_;
 
   std::vector<llvm::orc::VModuleKey> loaded_modules_;
 
   std::unordered_map<std::string, uintptr_t> external_symbols_;
+  std::vector<std::unique_ptr<llvm::MemoryBuffer>> runtime_libraries_;
   llvm::orc::DynamicLibrarySearchGenerator dynlib_generator_;
 
   friend class module_builder;
 
 private:
-  explicit compiler(llvm::orc::JITTargetMachineBuilder);
+  // A target machine builder adjusted by configure_target() to the requirements of the JIT.
+  struct configured_target {
+    llvm::orc::JITTargetMachineBuilder builder;
+  };
+
+  explicit compiler(configured_target);
+  static configured_target configure_target(llvm::orc::JITTargetMachineBuilder);
 
 public:
   compiler();
+  // Generates code for the given target instead of the host CPU, e.g. a CPU without some of the instruction set
+  // extensions. The code is executed in this process, so the target has to be compatible with the host.
+  explicit compiler(llvm::orc::JITTargetMachineBuilder);
   ~compiler();
 
   compiler(compiler const&) = delete;
@@ -73,7 +89,17 @@ public:
 
   void add_symbol(std::string const& name, void* address);
 
+  // Loads LLVM bitcode of a library of helper functions, e.g. built with codegen_add_runtime_library(). Functions used
+  // by a module are linked into it before the optimisations, which allows inlining them into the generated code. The
+  // library has to be loaded before any module that uses it is built.
+  void add_runtime_library(std::filesystem::path const& bitcode);
+
+  // Sets a function that is given the textual IR of each module after it has been optimised. Useful for checking
+  // whether the optimiser was able to take advantage of the information provided by the generated code.
+  void set_optimized_ir_handler(std::function<void(std::string const&)>);
+
 private:
+  llvm::Error link_runtime_libraries(llvm::Module&);
   llvm::Expected<llvm::orc::ThreadSafeModule> optimize_module(llvm::orc::ThreadSafeModule,
                                                               llvm::orc::MaterializationResponsibility const&);
 };
@@ -0,0 +1,306 @@
+/*
+ * Copyright © 2019 Paweł Dziepak
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "codegen/checked_ops.hpp"
+#include "codegen/module_builder.hpp"
+#include "codegen/relational_ops.hpp"
+
+namespace codegen {
+
+// Fixed-point decimal number with up to 38 significant digits, represented as a 128-bit integer equal to the number
+// multiplied by 10^Scale.
+template<unsigned Scale> struct decimal {
+  static_assert(Scale <= 38);
+
+  __int128 value;
+};
+
+namespace detail {
+
+template<typename Type> inline constexpr bool is_decimal_v = false;
+template<unsigned Scale> inline constexpr bool is_decimal_v<decimal<Scale>> = true;
+
+template<typename Type> inline constexpr unsigned decimal_scale_v = 0;
+template<unsigned Scale> inline constexpr unsigned decimal_scale_v<decimal<Scale>> = Scale;
+
+constexpr __int128 power_of_10(unsigned exponent) {
+  __int128 value = 1;
+  while (exponent--) { value *= 10; }
+  return value;
+}
+
+template<unsigned Scale> struct type<decimal<Scale>> {
+  static constexpr size_t alignment = alignof(decimal<Scale>);
+  static llvm::DIType* dbg() {
+    return current_builder->dbg_builder_.createBasicType(name(), 128, llvm::dwarf::DW_ATE_signed);
+  }
+  static llvm::Type* llvm() { return type<__int128>::llvm(); }
+  static std::string name() { return fmt::format("decimal(38, {})", Scale); }
+};
+
+enum class decimal_arithmetic_operation_type {
+  add,
+  sub,
+  mul,
+};
+
+template<decimal_arithmetic_operation_type Op, typename LHS, typename RHS> class decimal_arithmetic_operation {
+  LHS lhs_;
+  RHS rhs_;
+
+  static constexpr unsigned lhs_scale = decimal_scale_v<typename LHS::value_type>;
+  static constexpr unsigned rhs_scale = decimal_scale_v<typename RHS::value_type>;
+
+  static_assert(Op == decimal_arithmetic_operation_type::mul || lhs_scale == rhs_scale);
+
+public:
+  using value_type = std::conditional_t<Op == decimal_arithmetic_operation_type::mul, decimal<lhs_scale + rhs_scale>,
+                                        decimal<lhs_scale>>;
+
+  decimal_arithmetic_operation(LHS lhs, RHS rhs) : lhs_(std::move(lhs)), rhs_(std::move(rhs)) {}
+
+  llvm::Value* eval() const {
+    auto& mb = *current_builder;
+    switch (Op) {
+    case decimal_arithmetic_operation_type::add: return mb.ir_builder_.CreateAdd(lhs_.eval(), rhs_.eval());
+    case decimal_arithmetic_operation_type::sub: return mb.ir_builder_.CreateSub(lhs_.eval(), rhs_.eval());
+    case decimal_arithmetic_operation_type::mul: return mb.ir_builder_.CreateMul(lhs_.eval(), rhs_.eval());
+    }
+    abort();
+  }
+
+  friend std::ostream& operator<<(std::ostream& os, decimal_arithmetic_operation const& dao) {
+    auto symbol = [] {
+      switch (Op) {
+      case decimal_arithmetic_operation_type::add: return '+';
+      case decimal_arithmetic_operation_type::sub: return '-';
+      case decimal_arithmetic_operation_type::mul: return '*';
+      }
+    }();
+    return os << '(' << dao.lhs_ << ' ' << symbol << ' ' << dao.rhs_ << ')';
+  }
+};
+
+template<relational_operation_type Op, typename LHS, typename RHS> class decimal_relational_operation {
+  LHS lhs_;
+  RHS rhs_;
+
+  static_assert(std::is_same_v<typename LHS::value_type, typename RHS::value_type>);
+
+public:
+  using value_type = bool;
+
+  decimal_relational_operation(LHS lhs, RHS rhs) : lhs_(std::move(lhs)), rhs_(std::move(rhs)) {}
+
+  llvm::Value* eval() const {
+    auto predicate = [] {
+      switch (Op) {
+      case relational_operation_type::eq: return llvm::CmpInst::ICMP_EQ;
+      case relational_operation_type::ne: return llvm::CmpInst::ICMP_NE;
+      case relational_operation_type::ge: return llvm::CmpInst::ICMP_SGE;
+      case relational_operation_type::gt: return llvm::CmpInst::ICMP_SGT;
+      case relational_operation_type::le: return llvm::CmpInst::ICMP_SLE;
+      case relational_operation_type::lt: return llvm::CmpInst::ICMP_SLT;
+      }
+      abort();
+    }();
+    return current_builder->ir_builder_.CreateICmp(predicate, lhs_.eval(), rhs_.eval());
+  }
+
+  friend std::ostream& operator<<(std::ostream& os, decimal_relational_operation const& dro) {
+    auto symbol = [] {
+      switch (Op) {
+      case relational_operation_type::eq: return "==";
+      case relational_operation_type::ne: return "!=";
+      case relational_operation_type::ge: return ">=";
+      case relational_operation_type::gt: return ">";
+      case relational_operation_type::le: return "<=";
+      case relational_operation_type::lt: return "<";
+      }
+    }();
+    return os << '(' << dro.lhs_ << ' ' << symbol << ' ' << dro.rhs_ << ')';
+  }
+};
+
+template<typename Value, unsigned Scale> class rescale_impl {
+  Value value_;
+
+  static constexpr unsigned from_scale = decimal_scale_v<typename Value::value_type>;
+
+public:
+  using value_type = decimal<Scale>;
+
+  rescale_impl(Value v) : value_(std::move(v)) {}
+
+  llvm::Value* eval() const {
+    auto& mb = *current_builder;
+    if constexpr (Scale > from_scale) {
+      return mb.ir_builder_.CreateMul(value_.eval(), get_constant<__int128>(power_of_10(Scale - from_scale)));
+    } else if constexpr (Scale < from_scale) {
+      return mb.ir_builder_.CreateSDiv(value_.eval(), get_constant<__int128>(power_of_10(from_scale - Scale)));
+    } else {
+      return value_.eval();
+    }
+  }
+
+  friend std::ostream& operator<<(std::ostream& os, rescale_impl const& ri) {
+    return os << "rescale<" << Scale << ">(" << ri.value_ << ")";
+  }
+};
+
+template<typename LHS, typename RHS, unsigned Scale> class divide_impl {
+  LHS lhs_;
+  RHS rhs_;
+
+  static constexpr unsigned lhs_scale = decimal_scale_v<typename LHS::value_type>;
+  static constexpr unsigned rhs_scale = decimal_scale_v<typename RHS::value_type>;
+
+  static_assert(Scale + rhs_scale >= lhs_scale);
+  static_assert(Scale + rhs_scale - lhs_scale <= 38);
+
+public:
+  using value_type = decimal<Scale>;
+
+  divide_impl(LHS lhs, RHS rhs) : lhs_(std::move(lhs)), rhs_(std::move(rhs)) {}
+
+  llvm::Value* eval() const {
+    auto& mb = *current_builder;
+    auto dividend = lhs_.eval();
+    if constexpr (Scale + rhs_scale > lhs_scale) {
+      dividend = mb.ir_builder_.CreateMul(dividend, get_constant<__int128>(power_of_10(Scale + rhs_scale - lhs_scale)));
+    }
+    return mb.ir_builder_.CreateSDiv(dividend, rhs_.eval());
+  }
+
+  friend std::ostream& operator<<(std::ostream& os, divide_impl const& di) {
+    return os << "divide<" << Scale << ">(" << di.lhs_ << ", " << di.rhs_ << ")";
+  }
+};
+
+} // namespace detail
+
+// Decimal arithmetic wraps on 128-bit overflow. Addition and subtraction require both operands to have the same scale,
+// the scale of a product is the sum of the scales of the operands.
+
+template<typename LHS, typename RHS,
+         std::enable_if_t<detail::is_decimal_v<typename LHS::value_type> &&
+                          std::is_same_v<typename RHS::value_type, typename LHS::value_type>, int> = 0>
+auto operator+(LHS lhs, RHS rhs) {
+  return detail::decimal_arithmetic_operation<detail::decimal_arithmetic_operation_type::add, LHS, RHS>(
+      std::move(lhs), std::move(rhs));
+}
+
+template<typename LHS, typename RHS,
+         std::enable_if_t<detail::is_decimal_v<typename LHS::value_type> &&
+                          std::is_same_v<typename RHS::value_type, typename LHS::value_type>, int> = 0>
+auto operator-(LHS lhs, RHS rhs) {
+  return detail::decimal_arithmetic_operation<detail::decimal_arithmetic_operation_type::sub, LHS, RHS>(
+      std::move(lhs), std::move(rhs));
+}
+
+template<typename LHS, typename RHS,
+         std::enable_if_t<detail::is_decimal_v<typename LHS::value_type> &&
+                          detail::is_decimal_v<typename RHS::value_type>, int> = 0>
+auto operator*(LHS lhs, RHS rhs) {
+  return detail::decimal_arithmetic_operation<detail::decimal_arithmetic_operation_type::mul, LHS, RHS>(
+      std::move(lhs), std::move(rhs));
+}
+
+// The product of two decimals with 38 significant digits easily exceeds 128 bits. checked_mul() reports such
+// overflows the same way as for integers, see codegen/checked_ops.hpp.
+template<typename LHS, typename RHS,
+         std::enable_if_t<detail::is_decimal_v<typename LHS::value_type> &&
+                          detail::is_decimal_v<typename RHS::value_type>, int> = 0>
+auto checked_mul(LHS lhs, RHS rhs) {
+  using value_type =
+      typename detail::decimal_arithmetic_operation<detail::decimal_arithmetic_operation_type::mul, LHS,
+                                                    RHS>::value_type;
+  auto product = checked_mul(bit_cast<__int128>(std::move(lhs)), bit_cast<__int128>(std::move(rhs)));
+  return checked_value<value_type>{value<value_type>{product.result.eval(), fmt::format("{}", product.result)},
+                                   product.overflow};
+}
+
+template<typename LHS, typename RHS,
+         std::enable_if_t<detail::is_decimal_v<typename LHS::value_type> &&
+                          std::is_same_v<typename RHS::value_type, typename LHS::value_type>, int> = 0>
+auto operator==(LHS lhs, RHS rhs) {
+  return detail::decimal_relational_operation<detail::relational_operation_type::eq, LHS, RHS>(std::move(lhs),
+                                                                                                std::move(rhs));
+}
+
+template<typename LHS, typename RHS,
+         std::enable_if_t<detail::is_decimal_v<typename LHS::value_type> &&
+                          std::is_same_v<typename RHS::value_type, typename LHS::value_type>, int> = 0>
+auto operator!=(LHS lhs, RHS rhs) {
+  return detail::decimal_relational_operation<detail::relational_operation_type::ne, LHS, RHS>(std::move(lhs),
+                                                                                                std::move(rhs));
+}
+
+template<typename LHS, typename RHS,
+         std::enable_if_t<detail::is_decimal_v<typename LHS::value_type> &&
+                          std::is_same_v<typename RHS::value_type, typename LHS::value_type>, int> = 0>
+auto operator>=(LHS lhs, RHS rhs) {
+  return detail::decimal_relational_operation<detail::relational_operation_type::ge, LHS, RHS>(std::move(lhs),
+                                                                                                std::move(rhs));
+}
+
+template<typename LHS, typename RHS,
+         std::enable_if_t<detail::is_decimal_v<typename LHS::value_type> &&
+                          std::is_same_v<typename RHS::value_type, typename LHS::value_type>, int> = 0>
+auto operator>(LHS lhs, RHS rhs) {
+  return detail::decimal_relational_operation<detail::relational_operation_type::gt, LHS, RHS>(std::move(lhs),
+                                                                                                std::move(rhs));
+}
+
+template<typename LHS, typename RHS,
+         std::enable_if_t<detail::is_decimal_v<typename LHS::value_type> &&
+                          std::is_same_v<typename RHS::value_type, typename LHS::value_type>, int> = 0>
+auto operator<=(LHS lhs, RHS rhs) {
+  return detail::decimal_relational_operation<detail::relational_operation_type::le, LHS, RHS>(std::move(lhs),
+                                                                                                std::move(rhs));
+}
+
+template<typename LHS, typename RHS,
+         std::enable_if_t<detail::is_decimal_v<typename LHS::value_type> &&
+                          std::is_same_v<typename RHS::value_type, typename LHS::value_type>, int> = 0>
+auto operator<(LHS lhs, RHS rhs) {
+  return detail::decimal_relational_operation<detail::relational_operation_type::lt, LHS, RHS>(std::move(lhs),
+                                                                                                std::move(rhs));
+}
+
+// Changes the scale of a decimal. Digits that do not fit in the new scale are truncated towards zero.
+template<unsigned Scale, typename Value, typename = std::enable_if_t<detail::is_decimal_v<typename Value::value_type>>>
+auto rescale(Value v) {
+  return detail::rescale_impl<Value, Scale>(std::move(v));
+}
+
+// Divides two decimals producing a result with the requested scale. The quotient is truncated towards zero.
+template<unsigned Scale, typename LHS, typename RHS,
+         typename = std::enable_if_t<detail::is_decimal_v<typename LHS::value_type> &&
+                                     detail::is_decimal_v<typename RHS::value_type>>>
+auto divide(LHS lhs, RHS rhs) {
+  return detail::divide_impl<LHS, RHS, Scale>(std::move(lhs), std::move(rhs));
+}
+
+} // namespace codegen
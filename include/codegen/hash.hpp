@@ -0,0 +1,226 @@
+/*
+ * Copyright © 2019 Paweł Dziepak
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <array>
+
+#include "codegen/builtin.hpp"
+#include "codegen/module_builder.hpp"
+#include "codegen/utils.hpp"
+
+namespace codegen::builtin {
+
+namespace detail {
+
+constexpr std::array<uint32_t, 256> make_crc32c_table() {
+  auto table = std::array<uint32_t, 256>{};
+  for (uint32_t i = 0; i < 256; i++) {
+    auto crc = i;
+    for (auto j = 0; j < 8; j++) { crc = (crc >> 1) ^ (crc & 1 ? 0x82f63b78 : 0); }
+    table[i] = crc;
+  }
+  return table;
+}
+
+inline llvm::GlobalVariable* get_crc32c_table() {
+  auto& mb = *codegen::detail::current_builder;
+  if (auto table = mb.module_->getNamedGlobal("crc32c_table")) { return table; }
+  static constexpr auto values = make_crc32c_table();
+  auto init = llvm::ConstantDataArray::get(*mb.context_, llvm::ArrayRef<uint32_t>(values.data(), values.size()));
+  return new llvm::GlobalVariable(*mb.module_, init->getType(), true, llvm::GlobalValue::PrivateLinkage, init,
+                                  "crc32c_table");
+}
+
+template<typename Crc, typename Value> class crc32c_impl {
+  Crc crc_;
+  Value value_;
+
+  using input_type = typename Value::value_type;
+
+public:
+  using value_type = uint32_t;
+  static_assert(std::is_same_v<typename Crc::value_type, uint32_t>);
+  static_assert(std::is_integral_v<input_type> && !std::is_same_v<input_type, bool>);
+  static_assert(sizeof(input_type) <= sizeof(uint64_t));
+
+  crc32c_impl(Crc crc, Value v) : crc_(crc), value_(v) {}
+
+  llvm::Value* eval() const {
+    auto& mb = *codegen::detail::current_builder;
+    auto& irb = mb.ir_builder_;
+    auto crc = crc_.eval();
+    auto v = value_.eval();
+
+    if (mb.target_has_feature("sse4.2")) {
+      if constexpr (sizeof(input_type) == sizeof(uint64_t)) {
+        auto fn = llvm::Intrinsic::getDeclaration(mb.module_.get(), llvm::Intrinsic::x86_sse42_crc32_64_64);
+        auto ret = irb.CreateCall(fn, {irb.CreateZExt(crc, irb.getInt64Ty()), v});
+        return irb.CreateTrunc(ret, irb.getInt32Ty());
+      } else {
+        auto id = sizeof(input_type) == sizeof(uint8_t)
+                      ? llvm::Intrinsic::x86_sse42_crc32_32_8
+                      : sizeof(input_type) == sizeof(uint16_t) ? llvm::Intrinsic::x86_sse42_crc32_32_16
+                                                               : llvm::Intrinsic::x86_sse42_crc32_32_32;
+        auto fn = llvm::Intrinsic::getDeclaration(mb.module_.get(), id);
+        return irb.CreateCall(fn, {crc, v});
+      }
+    }
+
+    auto table = get_crc32c_table();
+    for (auto i = 0u; i < sizeof(input_type); i++) {
+      auto byte = irb.CreateZExt(irb.CreateTrunc(irb.CreateLShr(v, i * 8), irb.getInt8Ty()), irb.getInt32Ty());
+      auto index = irb.CreateZExt(irb.CreateAnd(irb.CreateXor(crc, byte), 0xff), irb.getInt64Ty());
+      auto entry = irb.CreateAlignedLoad(irb.CreateInBoundsGEP(table, {irb.getInt64(0), index}), alignof(uint32_t));
+      crc = irb.CreateXor(entry, irb.CreateLShr(crc, 8));
+    }
+    return crc;
+  }
+
+  friend std::ostream& operator<<(std::ostream& os, crc32c_impl ci) {
+    return os << "crc32c(" << ci.crc_ << ", " << ci.value_ << ")";
+  }
+};
+
+inline constexpr uint64_t hash_secret[] = {0xa0761d6478bd642full, 0xe7037ed1a0b428dbull};
+
+// Folds the 128-bit product of two 64-bit values into 64 bits.
+inline llvm::Value* hash_mix(llvm::Value* a, llvm::Value* b) {
+  auto& irb = codegen::detail::current_builder->ir_builder_;
+  auto wide_type = codegen::detail::type<unsigned __int128>::llvm();
+  auto product = irb.CreateMul(irb.CreateZExt(a, wide_type), irb.CreateZExt(b, wide_type));
+  return irb.CreateXor(irb.CreateTrunc(product, irb.getInt64Ty()),
+                       irb.CreateTrunc(irb.CreateLShr(product, 64), irb.getInt64Ty()));
+}
+
+inline llvm::Value* hash_combine(llvm::Value* state, llvm::Value* v) {
+  auto& irb = codegen::detail::current_builder->ir_builder_;
+  return hash_mix(irb.CreateXor(state, irb.getInt64(hash_secret[0])), irb.CreateXor(v, irb.getInt64(hash_secret[1])));
+}
+
+} // namespace detail
+
+// A single step of CRC32C (Castagnoli), equivalent to the SSE 4.2 crc32 instruction, which is used if the host
+// supports it. The initial value and the final inversion, if needed, are the responsibility of the caller.
+template<typename Crc, typename Value> auto crc32c(Crc crc, Value v) {
+  return detail::crc32c_impl<Crc, Value>(crc, v);
+}
+
+// Hashes a sequence of values and byte ranges into a 64-bit hash using a multiply-and-fold mix. The hash is not
+// suitable for cryptographic purposes.
+class hasher {
+  llvm::Value* state_;
+  std::string name_;
+
+public:
+  explicit hasher(uint64_t seed = 0)
+      : state_(codegen::detail::get_constant<uint64_t>(seed)), name_(std::to_string(seed)) {}
+
+  template<typename Value> hasher& add(Value v) {
+    using value_type = typename Value::value_type;
+    static_assert(std::is_arithmetic_v<value_type> || std::is_pointer_v<value_type>);
+    static_assert(sizeof(value_type) <= sizeof(uint64_t));
+
+    auto& mb = *codegen::detail::current_builder;
+    auto& irb = mb.ir_builder_;
+
+    auto name = fmt::format("hash{}", codegen::detail::id_counter++);
+    auto line_no = mb.source_code_.add_line(fmt::format("{} = hash_combine({}, {});", name, name_, v));
+    irb.SetCurrentDebugLocation(llvm::DebugLoc::get(line_no, 1, mb.dbg_scope_));
+
+    auto x = v.eval();
+    if constexpr (std::is_pointer_v<value_type>) {
+      x = irb.CreatePtrToInt(x, irb.getInt64Ty());
+    } else if constexpr (std::is_floating_point_v<value_type>) {
+      x = irb.CreateZExt(irb.CreateBitCast(x, irb.getIntNTy(sizeof(value_type) * 8)), irb.getInt64Ty());
+    } else {
+      x = irb.CreateZExtOrBitCast(x, irb.getInt64Ty());
+    }
+    state_ = detail::hash_combine(state_, x);
+    name_ = std::move(name);
+    return *this;
+  }
+
+  // Hashes n bytes starting at ptr. The result depends only on the contents of the range and not on its alignment.
+  template<typename Pointer, typename Size> hasher& add_bytes(Pointer ptr, Size n) {
+    static_assert(std::is_pointer_v<typename Pointer::value_type>);
+    static_assert(std::is_integral_v<typename Size::value_type>);
+
+    auto& mb = *codegen::detail::current_builder;
+    auto& irb = mb.ir_builder_;
+
+    auto name = fmt::format("hash{}", codegen::detail::id_counter++);
+    auto line_no = mb.source_code_.add_line(fmt::format("{} = hash_combine_bytes({}, {}, {});", name, name_, ptr, n));
+    irb.SetCurrentDebugLocation(llvm::DebugLoc::get(line_no, 1, mb.dbg_scope_));
+
+    auto bytes = irb.CreatePointerCast(ptr.eval(), codegen::detail::type<std::byte const*>::llvm());
+    auto length = irb.CreateZExtOrTrunc(n.eval(), irb.getInt64Ty());
+    auto zero = irb.getInt64(0);
+
+    auto entry_block = irb.GetInsertBlock();
+    auto words_block = llvm::BasicBlock::Create(*mb.context_, "hash_words", mb.function_);
+    auto word_block = llvm::BasicBlock::Create(*mb.context_, "hash_word", mb.function_);
+    auto tail_block = llvm::BasicBlock::Create(*mb.context_, "hash_tail", mb.function_);
+    auto tail_byte_block = llvm::BasicBlock::Create(*mb.context_, "hash_tail_byte", mb.function_);
+    auto end_block = llvm::BasicBlock::Create(*mb.context_, "hash_end", mb.function_);
+    irb.CreateBr(words_block);
+
+    irb.SetInsertPoint(words_block);
+    auto offset = irb.CreatePHI(irb.getInt64Ty(), 2);
+    auto state = irb.CreatePHI(irb.getInt64Ty(), 2);
+    offset->addIncoming(zero, entry_block);
+    state->addIncoming(state_, entry_block);
+    auto next_offset = irb.CreateAdd(offset, irb.getInt64(sizeof(uint64_t)));
+    irb.CreateCondBr(irb.CreateICmpULE(next_offset, length), word_block, tail_block);
+
+    irb.SetInsertPoint(word_block);
+    auto word_ptr = irb.CreatePointerCast(irb.CreateInBoundsGEP(bytes, offset),
+                                          codegen::detail::type<uint64_t const*>::llvm());
+    auto word = irb.CreateAlignedLoad(word_ptr, 1);
+    offset->addIncoming(next_offset, word_block);
+    state->addIncoming(detail::hash_combine(state, word), word_block);
+    irb.CreateBr(words_block);
+
+    irb.SetInsertPoint(tail_block);
+    auto index = irb.CreatePHI(irb.getInt64Ty(), 2);
+    auto tail = irb.CreatePHI(irb.getInt64Ty(), 2);
+    index->addIncoming(zero, words_block);
+    tail->addIncoming(zero, words_block);
+    auto tail_offset = irb.CreateAdd(offset, index);
+    irb.CreateCondBr(irb.CreateICmpULT(tail_offset, length), tail_byte_block, end_block);
+
+    irb.SetInsertPoint(tail_byte_block);
+    auto byte = irb.CreateZExt(irb.CreateAlignedLoad(irb.CreateInBoundsGEP(bytes, tail_offset), 1), irb.getInt64Ty());
+    index->addIncoming(irb.CreateAdd(index, irb.getInt64(1)), tail_byte_block);
+    tail->addIncoming(irb.CreateOr(tail, irb.CreateShl(byte, irb.CreateMul(index, irb.getInt64(8)))), tail_byte_block);
+    irb.CreateBr(tail_block);
+
+    irb.SetInsertPoint(end_block);
+    state_ = detail::hash_combine(detail::hash_combine(state, tail), length);
+    name_ = std::move(name);
+    return *this;
+  }
+
+  value<uint64_t> get() const { return value<uint64_t>{state_, name_}; }
+};
+
+} // namespace codegen::builtin
@@ -0,0 +1,90 @@
+/*
+ * Copyright © 2019 Paweł Dziepak
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "codegen/arithmetic_ops.hpp"
+#include "codegen/module_builder.hpp"
+#include "codegen/statements.hpp"
+
+namespace codegen {
+
+namespace detail {
+
+template<typename Index, typename State, typename Stage, typename... Stages>
+void interleave_stages(std::vector<value<Index>> const& indices, std::vector<State> const& states, Stage&& stage,
+                       Stages&&... stages) {
+  // The first stage has no state yet and gets only the index of the item.
+  auto invoke = [&](size_t i) -> decltype(auto) {
+    if constexpr (std::is_same_v<State, std::nullptr_t>) {
+      return stage(indices[i]);
+    } else {
+      return stage(indices[i], states[i]);
+    }
+  };
+  if constexpr (sizeof...(Stages) == 0) {
+    for (auto i = size_t(0); i < indices.size(); i++) { invoke(i); }
+  } else {
+    using next_state_type = decltype(let(invoke(0)));
+    auto next_states = std::vector<next_state_type>{};
+    for (auto i = size_t(0); i < indices.size(); i++) { next_states.emplace_back(let(invoke(i))); }
+    interleave_stages(indices, next_states, std::forward<Stages>(stages)...);
+  }
+}
+
+} // namespace detail
+
+// Group prefetching: for (i = 0; i < n; i++) stages(i), where the loop processes group_size independent items at a
+// time and each stage is run for all items in the group before the next one starts. A stage that prefetches the memory
+// needed by the next one lets the cache misses of the whole group overlap instead of stalling on each item in turn.
+// The first stage is called with the index of the item, the following ones with the index and the value returned by
+// the previous stage. The last stage returns nothing. Each stage is emitted group_size + 1 times, the last copy
+// handles the items left over after the final full group. For example, a probe of a chained hash table:
+//
+//   interleaved_for_(n, 8,
+//       [&](value<uint64_t> i) { auto b = let(buckets + hash(load(keys + i))); builtin::prefetch(b); return b; },
+//       [&](value<uint64_t> i, value<node*> b) { auto head = let(load(b)); builtin::prefetch(head); return head; },
+//       [&](value<uint64_t> i, value<node*> head) { /* walk the chain */ });
+template<typename End, typename... Stages> void interleaved_for_(End const& n, size_t group_size, Stages&&... stages) {
+  using value_type = typename End::value_type;
+  static_assert(std::is_integral_v<value_type> && !std::is_same_v<value_type, bool>);
+  static_assert(sizeof...(Stages) > 0);
+  assert(group_size > 0);
+
+  auto end = let(n);
+  auto group = constant<value_type>(group_size);
+  auto groups_end = let(end - end % group);
+
+  for_(constant<value_type>(0), groups_end, group, [&](value<value_type> first) {
+    auto indices = std::vector<value<value_type>>{first};
+    for (auto i = size_t(1); i < group_size; i++) { indices.emplace_back(let(first + constant<value_type>(i))); }
+    detail::interleave_stages(indices, std::vector<std::nullptr_t>(group_size), stages...);
+  });
+
+  for_(groups_end, end, constant<value_type>(1), [&](value<value_type> idx) {
+    detail::interleave_stages(std::vector<value<value_type>>{idx}, std::vector<std::nullptr_t>(1), stages...);
+  });
+}
+
+} // namespace codegen
@@ -16,6 +16,9 @@ value<int32_t> operator""_i32(unsigned long long v) {
 value<int64_t> operator""_i64(unsigned long long v) {
   return constant<int64_t>(v);
 }
+value<__int128> operator""_i128(unsigned long long v) {
+  return constant<__int128>(v);
+}
 
 value<uint8_t> operator""_u8(unsigned long long v) {
   return constant<uint8_t>(v);
@@ -29,6 +32,9 @@ value<uint32_t> operator""_u32(unsigned long long v) {
 value<uint64_t> operator""_u64(unsigned long long v) {
   return constant<uint64_t>(v);
 }
+value<unsigned __int128> operator""_u128(unsigned long long v) {
+  return constant<unsigned __int128>(v);
+}
 
 value<float> operator""_f32(long double v) {
   return constant<float>(v);
@@ -25,6 +25,7 @@
 namespace codegen {
 
 template<typename ReturnType, typename... Arguments> class function_ref;
+template<typename Type> class global_ref;
 
 class module {
   llvm::orc::ExecutionSession* session_;
@@ -46,6 +47,11 @@ public:
   auto get_address(function_ref<ReturnType, Arguments...> const& fn) {
     return reinterpret_cast<ReturnType (*)(Arguments...)>(get_address(fn.name()));
   }
+
+  // Thread-local variables have no address shared by all threads, looking them up fails.
+  template<typename Type> Type* get_address(global_ref<Type> const& gv) {
+    return reinterpret_cast<Type*>(get_address(gv.name()));
+  }
 };
 
 } // namespace codegen
@@ -22,13 +22,18 @@
 
 #pragma once
 
+#include <array>
 #include <filesystem>
+#include <initializer_list>
 #include <sstream>
 #include <string>
+#include <tuple>
+#include <vector>
 
 #include <llvm/IR/DIBuilder.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/MDBuilder.h>
 #include <llvm/IR/Module.h>
 
 #include <fmt/format.h>
@@ -51,6 +56,265 @@ public:
   std::string const& name() const { return name_; }
 };
 
+// A global variable or a constant table defined in a module. In the generated code it is a pointer to the variable
+// (or the first element of an array). The application can obtain the address of non-thread-local variables with
+// module::get_address().
+template<typename Type> class global_ref {
+  std::string name_;
+  llvm::GlobalVariable* variable_;
+  llvm::Constant* address_;
+
+public:
+  explicit global_ref(std::string const& name, llvm::GlobalVariable* gv, llvm::Constant* address)
+      : name_(name), variable_(gv), address_(address) {}
+
+  using value_type = Type*;
+
+  operator llvm::GlobalVariable*() const { return variable_; }
+
+  std::string const& name() const { return name_; }
+
+  llvm::Value* eval() const { return address_; }
+
+  friend std::ostream& operator<<(std::ostream& os, global_ref const& gr) { return os << gr.name_; }
+};
+
+// Functions of a generator created with module_builder::create_generator<Type(Arguments...)>(). The generator doesn't
+// allocate memory, start() places its frame in the memory provided by the caller, which has to be aligned to 16
+// bytes. On input, *frame_size is the size of that memory and, on output, the size of the frame. If the memory is too
+// small, start() returns nullptr, otherwise it returns the handle of the generator, which is suspended before the
+// first statement of its body. next() resumes the generator and stores the next yielded value in *out, or returns
+// false once the generator has finished. The frame owns no resources and can be discarded at any time.
+template<typename Type, typename... Arguments> struct generator_ref {
+  function_ref<std::byte*, std::byte*, uint64_t*, Arguments...> start;
+  function_ref<bool, std::byte*, Type*> next;
+};
+
+// Attributes of a pointer parameter of a function, passed to module_builder::create_function or
+// module_builder::declare_external_function, e.g. codegen::parameter<0>().noalias().align(32).
+template<size_t Index> class parameter_attributes {
+  std::vector<llvm::Attribute::AttrKind> kinds_;
+  unsigned alignment_ = 0;
+  uint64_t dereferenceable_ = 0;
+
+public:
+  static constexpr size_t index = Index;
+
+  // No other pointer used by the function accesses the memory accessed through this parameter.
+  parameter_attributes& noalias() {
+    kinds_.emplace_back(llvm::Attribute::NoAlias);
+    return *this;
+  }
+  parameter_attributes& nonnull() {
+    kinds_.emplace_back(llvm::Attribute::NonNull);
+    return *this;
+  }
+  parameter_attributes& readonly() {
+    kinds_.emplace_back(llvm::Attribute::ReadOnly);
+    return *this;
+  }
+  parameter_attributes& writeonly() {
+    kinds_.emplace_back(llvm::Attribute::WriteOnly);
+    return *this;
+  }
+  parameter_attributes& align(unsigned alignment) {
+    assert(alignment && !(alignment & (alignment - 1)));
+    alignment_ = alignment;
+    return *this;
+  }
+  // At least the given number of bytes can be loaded from the pointer without trapping.
+  parameter_attributes& dereferenceable(uint64_t bytes) {
+    dereferenceable_ = bytes;
+    return *this;
+  }
+
+  void apply(llvm::Function* fn) const {
+    for (auto kind : kinds_) { fn->addParamAttr(Index, kind); }
+    if (alignment_) { fn->addParamAttr(Index, llvm::Attribute::getWithAlignment(fn->getContext(), alignment_)); }
+    if (dereferenceable_) { fn->addDereferenceableParamAttr(Index, dereferenceable_); }
+  }
+};
+
+template<size_t Index> parameter_attributes<Index> parameter() {
+  return {};
+}
+
+// Relaxations of the IEEE semantics of floating-point operations, which allow LLVM, for example, to vectorise
+// reductions (reassoc) or fuse multiplication and addition into FMA (contract). By default all operations are strict.
+class fast_math_flags {
+  llvm::FastMathFlags flags_;
+
+public:
+  // Operations can be reassociated, e.g. a + (b + c) becomes (a + b) + c.
+  fast_math_flags& reassoc() {
+    flags_.setAllowReassoc();
+    return *this;
+  }
+  // Operations can be fused, e.g. a * b + c becomes fma(a, b, c).
+  fast_math_flags& contract() {
+    flags_.setAllowContract(true);
+    return *this;
+  }
+  // Arguments and results are assumed not to be NaN.
+  fast_math_flags& no_nans() {
+    flags_.setNoNaNs();
+    return *this;
+  }
+  // Arguments and results are assumed not to be infinities.
+  fast_math_flags& no_infs() {
+    flags_.setNoInfs();
+    return *this;
+  }
+  fast_math_flags& no_signed_zeros() {
+    flags_.setNoSignedZeros();
+    return *this;
+  }
+  // x / y can be replaced with x * (1 / y).
+  fast_math_flags& allow_reciprocal() {
+    flags_.setAllowReciprocal();
+    return *this;
+  }
+  // Functions such as sqrt can be replaced with approximations.
+  fast_math_flags& approx_func() {
+    flags_.setApproxFunc();
+    return *this;
+  }
+  fast_math_flags& fast() {
+    flags_.setFast();
+    return *this;
+  }
+
+  llvm::FastMathFlags get() const { return flags_; }
+
+  friend std::ostream& operator<<(std::ostream& os, fast_math_flags const& fmf) {
+    auto& flags = fmf.flags_;
+    if (flags.isFast()) { return os << "fast"; }
+    auto names = std::vector<char const*>{};
+    if (flags.allowReassoc()) { names.emplace_back("reassoc"); }
+    if (flags.allowContract()) { names.emplace_back("contract"); }
+    if (flags.noNaNs()) { names.emplace_back("nnan"); }
+    if (flags.noInfs()) { names.emplace_back("ninf"); }
+    if (flags.noSignedZeros()) { names.emplace_back("nsz"); }
+    if (flags.allowReciprocal()) { names.emplace_back("arcp"); }
+    if (flags.approxFunc()) { names.emplace_back("afn"); }
+    if (names.empty()) { return os << "strict"; }
+    for (auto i = size_t(0); i < names.size(); i++) { os << (i ? " " : "") << names[i]; }
+    return os;
+  }
+};
+
+class function_attributes {
+  std::vector<llvm::Attribute::AttrKind> kinds_;
+  std::string section_prefix_;
+  bool internal_ = false;
+  fast_math_flags fast_math_;
+
+public:
+  // The function doesn't access memory, only its arguments determine the result.
+  function_attributes& readnone() {
+    kinds_.emplace_back(llvm::Attribute::ReadNone);
+    return *this;
+  }
+  // The function doesn't write to memory.
+  function_attributes& readonly() {
+    kinds_.emplace_back(llvm::Attribute::ReadOnly);
+    return *this;
+  }
+  function_attributes& nounwind() {
+    kinds_.emplace_back(llvm::Attribute::NoUnwind);
+    return *this;
+  }
+
+  function_attributes& alwaysinline() {
+    kinds_.emplace_back(llvm::Attribute::AlwaysInline);
+    return *this;
+  }
+  function_attributes& noinline() {
+    kinds_.emplace_back(llvm::Attribute::NoInline);
+    return *this;
+  }
+  // The function is rarely called, e.g. an error handler. Calls to it are considered unlikely and its code is placed
+  // in a separate section.
+  function_attributes& cold() {
+    kinds_.emplace_back(llvm::Attribute::Cold);
+    section_prefix_ = ".unlikely";
+    return *this;
+  }
+  // LLVM 8 has no hot attribute, the function is only placed in a separate section, the same way profile-guided
+  // optimisations do it.
+  function_attributes& hot() {
+    section_prefix_ = ".hot";
+    return *this;
+  }
+  function_attributes& optsize() {
+    kinds_.emplace_back(llvm::Attribute::OptimizeForSize);
+    return *this;
+  }
+  function_attributes& minsize() {
+    kinds_.emplace_back(llvm::Attribute::OptimizeForSize);
+    kinds_.emplace_back(llvm::Attribute::MinSize);
+    return *this;
+  }
+  // The function can be called only by other generated functions in the same module. It uses the fast calling
+  // convention and is removed if it is not needed after inlining. Its address can't be obtained with
+  // module::get_address().
+  function_attributes& internal() {
+    internal_ = true;
+    return *this;
+  }
+
+  // Floating-point operations in the body of the function use the given fast-math flags, unless overridden with
+  // with_fast_math() or fast_math(). The flags are set only on the instructions and not as function attributes
+  // (e.g. "unsafe-fp-math"), which would make the code generator ignore such overrides.
+  function_attributes& fast_math(fast_math_flags const& flags) {
+    fast_math_ = flags;
+    return *this;
+  }
+
+  llvm::FastMathFlags get_fast_math_flags() const { return fast_math_.get(); }
+
+  void apply(llvm::Function* fn) const {
+    for (auto kind : kinds_) { fn->addFnAttr(kind); }
+    assert(!fn->hasFnAttribute(llvm::Attribute::AlwaysInline) || !fn->hasFnAttribute(llvm::Attribute::NoInline));
+    if (!section_prefix_.empty()) { fn->setSectionPrefix(section_prefix_); }
+    if (internal_) {
+      fn->setLinkage(llvm::GlobalValue::InternalLinkage);
+      fn->setCallingConv(llvm::CallingConv::Fast);
+    }
+  }
+};
+
+// Attributes of a global variable, passed to module_builder::create_global and similar functions.
+class global_attributes {
+  unsigned alignment_ = 0;
+  std::string section_;
+  bool is_thread_local_ = false;
+
+public:
+  global_attributes& align(unsigned alignment) {
+    assert(alignment && !(alignment & (alignment - 1)));
+    alignment_ = alignment;
+    return *this;
+  }
+  global_attributes& section(std::string const& name) {
+    section_ = name;
+    return *this;
+  }
+  // Each thread has its own instance of the variable, initialised with the initial value.
+  global_attributes& thread_local_() {
+    is_thread_local_ = true;
+    return *this;
+  }
+
+  bool is_thread_local() const { return is_thread_local_; }
+
+  void apply(llvm::GlobalVariable* gv) const {
+    if (alignment_) { gv->setAlignment(alignment_); }
+    if (!section_.empty()) { gv->setSection(section_); }
+    gv->setThreadLocal(is_thread_local_);
+  }
+};
+
 class module_builder {
   compiler* compiler_;
 
@@ -82,6 +346,17 @@ public: // FIXME: proper encapsulation
     llvm::BasicBlock* break_block_ = nullptr;
   };
   loop current_loop_;
+  // Set while the body of a generator is being generated.
+  struct coroutine {
+    llvm::AllocaInst* promise_ = nullptr;
+    llvm::BasicBlock* final_suspend_block_ = nullptr;
+    llvm::BasicBlock* cleanup_block_ = nullptr;
+    llvm::BasicBlock* suspend_block_ = nullptr;
+  };
+  coroutine current_coroutine_;
+  // Memory accesses in the body of a loop which iterations are independent are marked with the loop access group, or
+  // with the list of groups of all enclosing parallel loops.
+  llvm::MDNode* access_group_ = nullptr;
   bool exited_block_ = false;
 
   llvm::DIBuilder dbg_builder_;
@@ -95,12 +370,46 @@ public:
   module_builder(module_builder const&) = delete;
   module_builder(module_builder&&) = delete;
 
-  template<typename FunctionType, typename FunctionBuilder>
-  auto create_function(std::string const& name, FunctionBuilder&& fb);
-
-  template<typename FunctionType> auto declare_external_function(std::string const& name, FunctionType* fn);
+  // Attributes are any number of function_attributes and parameter_attributes. They are promises made to the
+  // optimiser, the behaviour is undefined if the function or its callers violate them.
+  template<typename FunctionType, typename FunctionBuilder, typename... Attributes>
+  auto create_function(std::string const& name, FunctionBuilder&& fb, Attributes const&... attrs);
+
+  // Generators are functions that produce a sequence of values with yield_() and are resumed by their caller, see
+  // generator_ref. FunctionType is Type(Arguments...), where Type is the type of the yielded values.
+  template<typename FunctionType, typename GeneratorBuilder>
+  auto create_generator(std::string const& name, GeneratorBuilder&& gb);
+
+  template<typename FunctionType, typename... Attributes>
+  auto declare_external_function(std::string const& name, FunctionType* fn, Attributes const&... attrs);
+  // Declares a function defined in a runtime library loaded with compiler::add_runtime_library(). Unlike external
+  // functions, it can be inlined into the generated code.
+  template<typename FunctionType, typename... Attributes>
+  auto declare_runtime_function(std::string const& name, Attributes const&... attrs);
+
+  // Declares a stateful callable, e.g. a lambda with captures. The generated code calls a thunk which gets the address
+  // of the callable as a constant. The callable has to outlive the module.
+  template<typename FunctionType, typename Callable, typename = std::enable_if_t<std::is_class_v<Callable>>>
+  auto declare_external_function(std::string const& name, Callable* callable);
+
+  template<typename Type>
+  global_ref<Type> create_global(std::string const& name, Type initial_value, global_attributes const& attrs = {});
+  // A zero-initialised array.
+  template<typename Type>
+  global_ref<Type> create_global_array(std::string const& name, size_t size, global_attributes const& attrs = {});
+  // Read-only data embedded in the module, e.g. a lookup table. The optimiser may fold loads with known indices.
+  template<typename Type>
+  global_ref<Type const> create_constant_array(std::string const& name, Type const* data, size_t size,
+                                               global_attributes const& attrs = {});
+
+  // Checks whether the target of the compiler supports a CPU feature, e.g. "bmi2". Code using target-specific
+  // intrinsics has to fall back to a generic implementation if it doesn't.
+  bool target_has_feature(std::string const& name) const;
 
   [[nodiscard]] module build() &&;
+  // Only the entry points can be called by the application. All other functions become internal, which allows LLVM
+  // to remove them once they are inlined (see function_attributes::internal()).
+  [[nodiscard]] module build(std::initializer_list<llvm::Function*> entry_points) &&;
 
   friend std::ostream& operator<<(std::ostream&, module_builder const&);
 
@@ -108,12 +417,38 @@ private:
   void set_function_attributes(llvm::Function*);
 
   void declare_external_symbol(std::string const&, void*);
+
+  llvm::GlobalVariable* create_global_variable(std::string const& name, llvm::Constant* initializer, bool is_constant,
+                                               llvm::DIType*, std::string const& declaration,
+                                               global_attributes const&);
+};
+
+template<typename Type, size_t Size> struct vec {
+  static_assert(std::is_arithmetic_v<Type>);
+  static_assert(Size > 0 && (Size & (Size - 1)) == 0);
+
+  Type data[Size];
 };
 
+template<size_t Size> using mask = vec<bool, Size>;
+
 namespace detail {
 
 inline thread_local module_builder* current_builder;
 
+template<typename Type> struct element_type { using type = Type; };
+template<typename Type, size_t Size> struct element_type<vec<Type, Size>> { using type = Type; };
+template<typename Type> using element_type_t = typename element_type<Type>::type;
+
+template<typename Type, typename Element> struct rebind_element { using type = Element; };
+template<typename Type, size_t Size, typename Element> struct rebind_element<vec<Type, Size>, Element> {
+  using type = vec<Element, Size>;
+};
+template<typename Type, typename Element> using rebind_element_t = typename rebind_element<Type, Element>::type;
+
+template<typename Type> inline constexpr size_t vector_size_v = 1;
+template<typename Type, size_t Size> inline constexpr size_t vector_size_v<vec<Type, Size>> = Size;
+
 template<typename Type> struct type {
   static_assert(std::is_integral_v<Type>);
   static constexpr size_t alignment = alignof(Type);
@@ -170,9 +505,72 @@ template<typename Type> struct type<Type*> {
   static llvm::Type* llvm() { return type<std::remove_cv_t<Type>>::llvm()->getPointerTo(); }
   static std::string name() { return type<std::remove_cv_t<Type>>::name() + '*'; }
 };
+// Function types are only used as pointees of function pointers.
+template<typename ReturnType, typename... Arguments> struct type<ReturnType(Arguments...)> {
+  static llvm::DIType* dbg() {
+    auto& db = current_builder->dbg_builder_;
+    return db.createSubroutineType(db.getOrCreateTypeArray({type<ReturnType>::dbg(), type<Arguments>::dbg()...}));
+  }
+  static llvm::Type* llvm() {
+    return llvm::FunctionType::get(type<ReturnType>::llvm(), {type<Arguments>::llvm()...}, false);
+  }
+  static std::string name() {
+    auto str = type<ReturnType>::name() + '(';
+    auto separator = "";
+    (void)((str += separator + type<Arguments>::name(), separator = ", "), ...);
+    return str + ')';
+  }
+};
+
+template<typename Type, size_t Size> struct type<vec<Type, Size>> {
+  static constexpr size_t alignment = alignof(Type);
+  static llvm::DIType* dbg() {
+    auto& db = current_builder->dbg_builder_;
+    return db.createVectorType(sizeof(Type) * Size * 8, alignof(Type) * 8, type<Type>::dbg(),
+                               db.getOrCreateArray({db.getOrCreateSubrange(0, Size)}));
+  }
+  static llvm::Type* llvm() { return llvm::VectorType::get(type<Type>::llvm(), Size); }
+  static std::string name() { return fmt::format("{}x{}", type<Type>::name(), Size); }
+};
+// Masks are vectors of i1 and have no in-memory representation that would match bool[Size].
+template<size_t Size> struct type<vec<bool, Size>> {
+  static llvm::DIType* dbg() {
+    auto& db = current_builder->dbg_builder_;
+    return db.createVectorType(Size * 8, 8, type<bool>::dbg(), db.getOrCreateArray({db.getOrCreateSubrange(0, Size)}));
+  }
+  static llvm::Type* llvm() { return llvm::VectorType::get(type<bool>::llvm(), Size); }
+  static std::string name() { return fmt::format("mask{}", Size); }
+};
+
+// Type-based alias analysis follows the C++ rules, so that the generated code can access memory shared with the
+// application: std::byte and 8-bit integers may alias anything, integers of the same width alias regardless of their
+// signedness and all pointers may alias each other. Vectors are treated as their elements.
+template<typename Type> llvm::MDNode* get_tbaa_access_tag() {
+  using scalar_type = element_type_t<Type>;
+  auto md = llvm::MDBuilder(*current_builder->context_);
+  auto byte_node = md.createTBAAScalarTypeNode("byte", md.createTBAARoot("codegen tbaa"));
+  auto type_node = [&]() -> llvm::MDNode* {
+    if constexpr (std::is_same_v<scalar_type, bool>) {
+      return md.createTBAAScalarTypeNode("bool", byte_node);
+    } else if constexpr (std::is_pointer_v<scalar_type>) {
+      return md.createTBAAScalarTypeNode("pointer", byte_node);
+    } else if constexpr (std::is_floating_point_v<scalar_type>) {
+      return md.createTBAAScalarTypeNode(type<scalar_type>::name(), byte_node);
+    } else if constexpr (std::is_integral_v<scalar_type> && sizeof(scalar_type) > 1) {
+      return md.createTBAAScalarTypeNode(fmt::format("int{}", sizeof(scalar_type) * 8), byte_node);
+    } else {
+      return byte_node;
+    }
+  }();
+  return md.createTBAAStructTagNode(type_node, type_node, 0);
+}
 
 template<typename Type> std::enable_if_t<std::is_arithmetic_v<Type>, llvm::Value*> get_constant(Type v) {
-  if constexpr (std::is_integral_v<Type>) {
+  if constexpr (std::is_integral_v<Type> && sizeof(Type) > sizeof(uint64_t)) {
+    auto bits = static_cast<unsigned __int128>(v);
+    uint64_t words[] = {uint64_t(bits), uint64_t(bits >> 64)};
+    return llvm::ConstantInt::get(*current_builder->context_, llvm::APInt(sizeof(Type) * 8, words));
+  } else if constexpr (std::is_integral_v<Type>) {
     return llvm::ConstantInt::get(*current_builder->context_, llvm::APInt(sizeof(Type) * 8, v, std::is_signed_v<Type>));
   } else if constexpr (std::is_floating_point_v<Type>) {
     return llvm::ConstantFP::get(*current_builder->context_, llvm::APFloat(v));
@@ -183,6 +581,30 @@ template<> inline llvm::Value* get_constant<bool>(bool v) {
   return llvm::ConstantInt::get(*current_builder->context_, llvm::APInt(1, v, true));
 }
 
+// Host addresses are valid in the generated code, since it runs in the same process.
+template<typename Type> std::enable_if_t<std::is_pointer_v<Type>, llvm::Value*> get_constant(Type v) {
+  auto address = llvm::ConstantInt::get(*current_builder->context_,
+                                        llvm::APInt(sizeof(Type) * 8, reinterpret_cast<uintptr_t>(v)));
+  return llvm::ConstantExpr::getIntToPtr(address, type<Type>::llvm());
+}
+
+// std::to_string() has no overloads for 128-bit integers.
+template<typename Type> std::string int128_to_string(Type v) {
+  auto magnitude = static_cast<unsigned __int128>(v);
+  auto negative = false;
+  if constexpr (std::is_signed_v<Type>) {
+    negative = v < 0;
+    if (negative) { magnitude = -magnitude; }
+  }
+  auto str = std::string{};
+  do {
+    str.push_back('0' + magnitude % 10);
+    magnitude /= 10;
+  } while (magnitude);
+  if (negative) { str.push_back('-'); }
+  return std::string(str.rbegin(), str.rend());
+}
+
 } // namespace detail
 
 template<typename Type> class value {
@@ -213,6 +635,10 @@ template<typename Type> value<Type> constant(Type v) {
   return value<Type>{detail::get_constant<Type>(v), [&] {
                        if constexpr (std::is_same_v<Type, bool>) {
                          return v ? "true" : "false";
+                       } else if constexpr (std::is_pointer_v<Type>) {
+                         return fmt::format("{}", reinterpret_cast<void const*>(v));
+                       } else if constexpr (sizeof(Type) > sizeof(uint64_t)) {
+                         return detail::int128_to_string(v);
                        } else {
                          return std::to_string(v);
                        }
@@ -237,7 +663,7 @@ public:
 
   bit_cast_impl(FromValue fv) : from_value_(fv) {}
 
-  llvm::Value* eval() {
+  llvm::Value* eval() const {
     return detail::current_builder->ir_builder_.CreateBitCast(from_value_.eval(), type<ToType>::llvm());
   }
 
@@ -249,37 +675,38 @@ public:
 template<typename FromValue, typename ToType> class cast_impl {
   FromValue from_value_;
 
-  using from_type = typename FromValue::value_type;
-  using to_type = ToType;
+  using from_type = element_type_t<typename FromValue::value_type>;
+  using to_type = element_type_t<ToType>;
 
 public:
-  static_assert(!std::is_pointer_v<from_type> && !std::is_pointer_v<ToType>);
+  static_assert(!std::is_pointer_v<from_type> && !std::is_pointer_v<to_type>);
+  static_assert(vector_size_v<typename FromValue::value_type> == vector_size_v<ToType>);
 
   using value_type = ToType;
 
   cast_impl(FromValue fv) : from_value_(fv) {}
 
-  llvm::Value* eval() {
+  llvm::Value* eval() const {
     auto& mb = *current_builder;
     if constexpr (std::is_floating_point_v<from_type> && std::is_floating_point_v<to_type>) {
-      return mb.ir_builder_.CreateFPCast(from_value_.eval(), type<to_type>::llvm());
+      return mb.ir_builder_.CreateFPCast(from_value_.eval(), type<ToType>::llvm());
     } else if constexpr (std::is_floating_point_v<from_type> && std::is_integral_v<to_type>) {
       if constexpr (std::is_signed_v<to_type>) {
-        return mb.ir_builder_.CreateFPToSI(from_value_.eval(), type<to_type>::llvm());
+        return mb.ir_builder_.CreateFPToSI(from_value_.eval(), type<ToType>::llvm());
       } else {
-        return mb.ir_builder_.CreateFPToUI(from_value_.eval(), type<to_type>::llvm());
+        return mb.ir_builder_.CreateFPToUI(from_value_.eval(), type<ToType>::llvm());
       }
     } else if constexpr (std::is_integral_v<from_type> && std::is_floating_point_v<to_type>) {
       if constexpr (std::is_signed_v<from_type>) {
-        return mb.ir_builder_.CreateSIToFP(from_value_.eval(), type<to_type>::llvm());
+        return mb.ir_builder_.CreateSIToFP(from_value_.eval(), type<ToType>::llvm());
       } else {
-        return mb.ir_builder_.CreateUIToFP(from_value_.eval(), type<to_type>::llvm());
+        return mb.ir_builder_.CreateUIToFP(from_value_.eval(), type<ToType>::llvm());
       }
     } else if constexpr (std::is_integral_v<from_type> && std::is_integral_v<to_type>) {
       if constexpr (std::is_signed_v<from_type>) {
-        return mb.ir_builder_.CreateSExtOrTrunc(from_value_.eval(), type<to_type>::llvm());
+        return mb.ir_builder_.CreateSExtOrTrunc(from_value_.eval(), type<ToType>::llvm());
       } else {
-        return mb.ir_builder_.CreateZExtOrTrunc(from_value_.eval(), type<to_type>::llvm());
+        return mb.ir_builder_.CreateZExtOrTrunc(from_value_.eval(), type<ToType>::llvm());
       }
     }
   }
@@ -289,6 +716,32 @@ public:
   }
 };
 
+template<typename Condition, typename TrueValue, typename FalseValue> class select_impl {
+  Condition condition_;
+  TrueValue true_value_;
+  FalseValue false_value_;
+
+  using condition_type = typename Condition::value_type;
+
+public:
+  static_assert(std::is_same_v<typename TrueValue::value_type, typename FalseValue::value_type>);
+  static_assert(std::is_same_v<condition_type, bool> ||
+                std::is_same_v<condition_type, rebind_element_t<typename TrueValue::value_type, bool>>);
+
+  using value_type = typename TrueValue::value_type;
+
+  select_impl(Condition cnd, TrueValue tv, FalseValue fv)
+      : condition_(std::move(cnd)), true_value_(std::move(tv)), false_value_(std::move(fv)) {}
+
+  llvm::Value* eval() const {
+    return current_builder->ir_builder_.CreateSelect(condition_.eval(), true_value_.eval(), false_value_.eval());
+  }
+
+  friend std::ostream& operator<<(std::ostream& os, select_impl const& si) {
+    return os << "select(" << si.condition_ << ", " << si.true_value_ << ", " << si.false_value_ << ")";
+  }
+};
+
 } // namespace detail
 
 template<typename ToType, typename FromValue> auto bit_cast(FromValue v) {
@@ -299,10 +752,20 @@ template<typename ToType, typename FromValue> auto cast(FromValue v) {
   return detail::cast_impl<FromValue, ToType>(v);
 }
 
+// Evaluates both values and chooses one of them without branching. If the condition is a mask the choice is made
+// separately for each lane.
+template<typename Condition, typename TrueValue, typename FalseValue>
+auto select(Condition cnd, TrueValue true_value, FalseValue false_value) {
+  return detail::select_impl<Condition, TrueValue, FalseValue>(std::move(cnd), std::move(true_value),
+                                                               std::move(false_value));
+}
+
+// In a generator, return_() finishes it.
 void return_();
 
 template<typename Value> void return_(Value v) {
   auto& mb = *detail::current_builder;
+  assert(!mb.current_coroutine_.promise_);
   mb.exited_block_ = true;
   auto line_no = mb.source_code_.add_line(fmt::format("return {};", v));
   mb.ir_builder_.SetCurrentDebugLocation(llvm::DebugLoc::get(line_no, 1, mb.dbg_scope_));
@@ -311,6 +774,24 @@ template<typename Value> void return_(Value v) {
 
 namespace detail {
 
+template<typename ReturnType, typename... Arguments>
+void apply_attributes(function_ref<ReturnType, Arguments...> fn, function_attributes const& attrs) {
+  attrs.apply(fn);
+}
+
+template<typename ReturnType, typename... Arguments, size_t Index>
+void apply_attributes(function_ref<ReturnType, Arguments...> fn, parameter_attributes<Index> const& attrs) {
+  static_assert(Index < sizeof...(Arguments), "parameter index out of range");
+  static_assert(std::is_pointer_v<std::tuple_element_t<Index, std::tuple<Arguments...>>>,
+                "parameter attributes are allowed only for pointers");
+  attrs.apply(fn);
+}
+
+inline void apply_fast_math_flags(function_attributes const& attrs) {
+  current_builder->ir_builder_.setFastMathFlags(attrs.get_fast_math_flags());
+}
+template<size_t Index> void apply_fast_math_flags(parameter_attributes<Index> const&) {}
+
 template<typename> class function_builder;
 
 template<typename ReturnType, typename... Arguments> class function_builder<ReturnType(Arguments...)> {
@@ -349,11 +830,16 @@ template<typename ReturnType, typename... Arguments> class function_builder<Retu
   }
 
 public:
-  template<typename FunctionBuilder>
-  function_ref<ReturnType, Arguments...> operator()(std::string const& name, FunctionBuilder&& fb) {
+  template<typename FunctionBuilder, typename... Attributes>
+  function_ref<ReturnType, Arguments...> operator()(std::string const& name, FunctionBuilder&& fb,
+                                                    Attributes const&... attrs) {
     auto& mb = *current_builder;
     auto fn_type = llvm::FunctionType::get(type<ReturnType>::llvm(), {type<Arguments>::llvm()...}, false);
     auto fn = llvm::Function::Create(fn_type, llvm::GlobalValue::LinkageTypes::ExternalLinkage, name, mb.module_.get());
+    auto fn_ref = function_ref<ReturnType, Arguments...>{name, fn};
+    (apply_attributes(fn_ref, attrs), ...);
+    mb.ir_builder_.clearFastMathFlags();
+    (apply_fast_math_flags(attrs), ...);
 
     std::vector<llvm::Metadata*> dbg_types = {detail::type<ReturnType>::dbg(), detail::type<Arguments>::dbg()...};
     auto dbg_fn_type = mb.dbg_builder_.createSubroutineType(mb.dbg_builder_.getOrCreateTypeArray(dbg_types));
@@ -371,21 +857,22 @@ public:
 
     mb.function_ = fn;
     call_builder(std::index_sequence_for<Arguments...>{}, name, fb, fn->arg_begin());
+    mb.ir_builder_.clearFastMathFlags();
 
     mb.dbg_scope_ = parent_scope;
 
-    return function_ref<ReturnType, Arguments...>{name, fn};
+    return fn_ref;
   }
 };
 
 } // namespace detail
 
-template<typename FunctionType, typename FunctionBuilder>
-auto module_builder::create_function(std::string const& name, FunctionBuilder&& fb) {
+template<typename FunctionType, typename FunctionBuilder, typename... Attributes>
+auto module_builder::create_function(std::string const& name, FunctionBuilder&& fb, Attributes const&... attrs) {
   assert(detail::current_builder == this || !detail::current_builder);
   auto prev_builder = std::exchange(detail::current_builder, this);
   exited_block_ = false;
-  auto fn_ref = detail::function_builder<FunctionType>{}(name, fb);
+  auto fn_ref = detail::function_builder<FunctionType>{}(name, fb, attrs...);
   set_function_attributes(fn_ref);
   detail::current_builder = prev_builder;
   return fn_ref;
@@ -393,6 +880,41 @@ auto module_builder::create_function(std::string const& name, FunctionBuilder&&
 
 namespace detail {
 
+// The generator is lowered to LLVM switched-resume coroutine intrinsics.
+void begin_coroutine(llvm::Value* frame, llvm::Value* frame_size, llvm::Type* promise_type);
+void suspend_coroutine(bool final);
+void end_coroutine();
+void resume_coroutine(llvm::Value* handle, llvm::Value* out, unsigned promise_alignment);
+
+template<typename> class generator_builder;
+
+template<typename Type, typename... Arguments> class generator_builder<Type(Arguments...)> {
+public:
+  template<typename GeneratorBuilder>
+  generator_ref<Type, Arguments...> operator()(module_builder& mb, std::string const& name, GeneratorBuilder& gb) {
+    auto start = mb.create_function<std::byte*(std::byte*, uint64_t*, Arguments...)>(
+        name, [&](value<std::byte*> frame, value<uint64_t*> frame_size, value<Arguments>... args) {
+          begin_coroutine(frame.eval(), frame_size.eval(), type<Type>::llvm());
+          gb(std::move(args)...);
+          end_coroutine();
+        });
+    auto next = mb.create_function<bool(std::byte*, Type*)>(
+        name + "_next", [&](value<std::byte*> handle, value<Type*> out) {
+          resume_coroutine(handle.eval(), out.eval(), type<Type>::alignment);
+        });
+    return {start, next};
+  }
+};
+
+} // namespace detail
+
+template<typename FunctionType, typename GeneratorBuilder>
+auto module_builder::create_generator(std::string const& name, GeneratorBuilder&& gb) {
+  return detail::generator_builder<FunctionType>{}(*this, name, gb);
+}
+
+namespace detail {
+
 template<typename> class function_declaration_builder;
 
 template<typename ReturnType, typename... Arguments> class function_declaration_builder<ReturnType(Arguments...)> {
@@ -409,12 +931,15 @@ public:
 
 } // namespace detail
 
-template<typename FunctionType>
-auto module_builder::declare_external_function(std::string const& name, FunctionType* fn) {
+template<typename FunctionType, typename... Attributes>
+auto module_builder::declare_external_function(std::string const& name, FunctionType* fn,
+                                               Attributes const&... attrs) {
   assert(detail::current_builder == this || !detail::current_builder);
 
   auto prev_builder = std::exchange(detail::current_builder, this);
   auto fn_ref = detail::function_declaration_builder<FunctionType>{}(name);
+  (detail::apply_attributes(fn_ref, attrs), ...);
+  assert(!static_cast<llvm::Function*>(fn_ref)->hasLocalLinkage());
   detail::current_builder = prev_builder;
 
   declare_external_symbol(name, reinterpret_cast<void*>(fn));
@@ -422,4 +947,140 @@ auto module_builder::declare_external_function(std::string const& name, Function
   return fn_ref;
 }
 
+template<typename FunctionType, typename... Attributes>
+auto module_builder::declare_runtime_function(std::string const& name, Attributes const&... attrs) {
+  assert(detail::current_builder == this || !detail::current_builder);
+
+  auto prev_builder = std::exchange(detail::current_builder, this);
+  auto fn_ref = detail::function_declaration_builder<FunctionType>{}(name);
+  (detail::apply_attributes(fn_ref, attrs), ...);
+  assert(!static_cast<llvm::Function*>(fn_ref)->hasLocalLinkage());
+  detail::current_builder = prev_builder;
+
+  return fn_ref;
+}
+
+namespace detail {
+
+template<typename Callable, typename FunctionType> struct callable_thunk;
+
+template<typename Callable, typename ReturnType, typename... Arguments>
+struct callable_thunk<Callable, ReturnType(Arguments...)> {
+  using type = ReturnType(std::byte*, Arguments...);
+
+  static ReturnType call(std::byte* callable, Arguments... args) {
+    return (*reinterpret_cast<Callable*>(callable))(args...);
+  }
+};
+
+template<typename> class callable_declaration_builder;
+
+// The callable is represented in the module by an internal function that passes the address of the callable to the
+// thunk and is always inlined into its callers.
+template<typename ReturnType, typename... Arguments> class callable_declaration_builder<ReturnType(Arguments...)> {
+public:
+  function_ref<ReturnType, Arguments...> operator()(std::string const& name, llvm::Function* thunk,
+                                                    std::byte* callable) {
+    auto& mb = *current_builder;
+
+    auto fn_type = llvm::FunctionType::get(type<ReturnType>::llvm(), {type<Arguments>::llvm()...}, false);
+    auto fn = llvm::Function::Create(fn_type, llvm::GlobalValue::LinkageTypes::ExternalLinkage, name, mb.module_.get());
+    function_attributes{}.alwaysinline().internal().apply(fn);
+
+    auto ir_builder = llvm::IRBuilder<>(llvm::BasicBlock::Create(*mb.context_, "entry", fn));
+    auto args = std::vector<llvm::Value*>{get_constant(callable)};
+    for (auto& arg : fn->args()) { args.emplace_back(&arg); }
+    auto ret = ir_builder.CreateCall(thunk, args);
+    if constexpr (std::is_void_v<ReturnType>) {
+      ir_builder.CreateRetVoid();
+    } else {
+      ir_builder.CreateRet(ret);
+    }
+
+    return function_ref<ReturnType, Arguments...>{name, fn};
+  }
+};
+
+} // namespace detail
+
+template<typename FunctionType, typename Callable, typename>
+auto module_builder::declare_external_function(std::string const& name, Callable* callable) {
+  assert(detail::current_builder == this || !detail::current_builder);
+
+  using thunk = detail::callable_thunk<Callable, FunctionType>;
+  llvm::Function* thunk_fn = declare_external_function<typename thunk::type>(name + "_thunk", &thunk::call);
+
+  auto prev_builder = std::exchange(detail::current_builder, this);
+  auto address = reinterpret_cast<std::byte*>(const_cast<std::remove_cv_t<Callable>*>(callable));
+  auto fn_ref = detail::callable_declaration_builder<FunctionType>{}(name, thunk_fn, address);
+  set_function_attributes(fn_ref);
+  detail::current_builder = prev_builder;
+
+  return fn_ref;
+}
+
+namespace detail {
+
+template<typename Type> llvm::DIType* get_array_dbg_type(size_t size) {
+  auto& db = current_builder->dbg_builder_;
+  return db.createArrayType(sizeof(Type) * size * 8, alignof(Type) * 8, type<Type>::dbg(),
+                            db.getOrCreateArray({db.getOrCreateSubrange(0, size)}));
+}
+
+inline llvm::Constant* get_first_element(llvm::GlobalVariable* gv) {
+  auto zero = llvm::ConstantInt::get(llvm::Type::getInt64Ty(gv->getContext()), 0);
+  auto indices = std::array<llvm::Constant*, 2>{zero, zero};
+  return llvm::ConstantExpr::getInBoundsGetElementPtr(gv->getValueType(), gv, indices);
+}
+
+} // namespace detail
+
+template<typename Type>
+global_ref<Type> module_builder::create_global(std::string const& name, Type initial_value,
+                                               global_attributes const& attrs) {
+  static_assert(std::is_arithmetic_v<Type> || std::is_pointer_v<Type>);
+  assert(detail::current_builder == this || !detail::current_builder);
+
+  auto prev_builder = std::exchange(detail::current_builder, this);
+  auto init = constant<Type>(initial_value);
+  auto gv = create_global_variable(name, llvm::cast<llvm::Constant>(init.eval()), false, detail::type<Type>::dbg(),
+                                   fmt::format("{} {} = {};", detail::type<Type>::name(), name, init), attrs);
+  detail::current_builder = prev_builder;
+
+  return global_ref<Type>{name, gv, gv};
+}
+
+template<typename Type>
+global_ref<Type> module_builder::create_global_array(std::string const& name, size_t size,
+                                                     global_attributes const& attrs) {
+  static_assert(std::is_arithmetic_v<Type> || std::is_pointer_v<Type>);
+  assert(detail::current_builder == this || !detail::current_builder);
+
+  auto prev_builder = std::exchange(detail::current_builder, this);
+  auto init = llvm::ConstantAggregateZero::get(llvm::ArrayType::get(detail::type<Type>::llvm(), size));
+  auto gv = create_global_variable(name, init, false, detail::get_array_dbg_type<Type>(size),
+                                   fmt::format("{} {}[{}];", detail::type<Type>::name(), name, size), attrs);
+  detail::current_builder = prev_builder;
+
+  return global_ref<Type>{name, gv, detail::get_first_element(gv)};
+}
+
+template<typename Type>
+global_ref<Type const> module_builder::create_constant_array(std::string const& name, Type const* data, size_t size,
+                                                             global_attributes const& attrs) {
+  static_assert(std::is_arithmetic_v<Type> || std::is_pointer_v<Type>);
+  assert(detail::current_builder == this || !detail::current_builder);
+  assert(!attrs.is_thread_local());
+
+  auto prev_builder = std::exchange(detail::current_builder, this);
+  auto elements = std::vector<llvm::Constant*>{};
+  for (auto i = 0u; i < size; i++) { elements.emplace_back(llvm::cast<llvm::Constant>(detail::get_constant(data[i]))); }
+  auto init = llvm::ConstantArray::get(llvm::ArrayType::get(detail::type<Type>::llvm(), size), elements);
+  auto gv = create_global_variable(name, init, true, detail::get_array_dbg_type<Type>(size),
+                                   fmt::format("const {} {}[{}];", detail::type<Type>::name(), name, size), attrs);
+  detail::current_builder = prev_builder;
+
+  return global_ref<Type const>{name, gv, detail::get_first_element(gv)};
+}
+
 } // namespace codegen
@@ -41,11 +41,11 @@ template<relational_operation_type Op, typename LHS, typename RHS> class relatio
   LHS lhs_;
   RHS rhs_;
 
-  using operand_type = typename LHS::value_type;
+  using operand_type = element_type_t<typename LHS::value_type>;
   static_assert(std::is_same_v<typename LHS::value_type, typename RHS::value_type>);
 
 public:
-  using value_type = bool;
+  using value_type = rebind_element_t<typename LHS::value_type, bool>;
 
   relational_operation(LHS lhs, RHS rhs) : lhs_(std::move(lhs)), rhs_(std::move(rhs)) {}
 
@@ -106,48 +106,137 @@ public:
   }
 };
 
+enum class logical_operation_type {
+  and_,
+  or_,
+};
+
+// Short-circuit logical operations. The right-hand side is evaluated in a separate basic block that is executed only
+// if the left-hand side doesn't determine the result.
+template<logical_operation_type Op, typename LHS, typename RHS> class logical_operation {
+  LHS lhs_;
+  RHS rhs_;
+
+  static_assert(std::is_same_v<typename LHS::value_type, bool>);
+  static_assert(std::is_same_v<typename RHS::value_type, bool>);
+
+public:
+  using value_type = bool;
+
+  logical_operation(LHS lhs, RHS rhs) : lhs_(std::move(lhs)), rhs_(std::move(rhs)) {}
+
+  llvm::Value* eval() const {
+    auto& mb = *current_builder;
+
+    auto rhs_block = llvm::BasicBlock::Create(*mb.context_, "logical_rhs", mb.function_);
+    auto merge_block = llvm::BasicBlock::Create(*mb.context_, "logical_merge", mb.function_);
+
+    auto lhs = lhs_.eval();
+    auto lhs_block = mb.ir_builder_.GetInsertBlock();
+    if constexpr (Op == logical_operation_type::and_) {
+      mb.ir_builder_.CreateCondBr(lhs, rhs_block, merge_block);
+    } else {
+      mb.ir_builder_.CreateCondBr(lhs, merge_block, rhs_block);
+    }
+
+    mb.ir_builder_.SetInsertPoint(rhs_block);
+    auto rhs = rhs_.eval();
+    auto rhs_end_block = mb.ir_builder_.GetInsertBlock();
+    mb.ir_builder_.CreateBr(merge_block);
+
+    mb.ir_builder_.SetInsertPoint(merge_block);
+    auto result = mb.ir_builder_.CreatePHI(type<bool>::llvm(), 2);
+    result->addIncoming(get_constant<bool>(Op == logical_operation_type::or_), lhs_block);
+    result->addIncoming(rhs, rhs_end_block);
+    return result;
+  }
+
+  friend std::ostream& operator<<(std::ostream& os, logical_operation const& lo) {
+    auto symbol = Op == logical_operation_type::and_ ? "&&" : "||";
+    return os << '(' << lo.lhs_ << ' ' << symbol << ' ' << lo.rhs_ << ')';
+  }
+};
+
+template<typename Value> class logical_not_operation {
+  Value value_;
+
+public:
+  using value_type = typename Value::value_type;
+  static_assert(std::is_same_v<element_type_t<value_type>, bool>);
+
+  explicit logical_not_operation(Value v) : value_(std::move(v)) {}
+
+  llvm::Value* eval() const { return current_builder->ir_builder_.CreateNot(value_.eval()); }
+
+  friend std::ostream& operator<<(std::ostream& os, logical_not_operation const& lno) {
+    return os << '!' << lno.value_;
+  }
+};
+
 } // namespace detail
 
 template<typename LHS, typename RHS,
-         typename = std::enable_if_t<std::is_arithmetic_v<typename RHS::value_type> &&
+         typename = std::enable_if_t<std::is_arithmetic_v<detail::element_type_t<typename RHS::value_type>> &&
                                      std::is_same_v<typename RHS::value_type, typename LHS::value_type>>>
 auto operator==(LHS lhs, RHS rhs) {
   return detail::relational_operation<detail::relational_operation_type::eq, LHS, RHS>(std::move(lhs), std::move(rhs));
 }
 
 template<typename LHS, typename RHS,
-         typename = std::enable_if_t<std::is_arithmetic_v<typename RHS::value_type> &&
+         typename = std::enable_if_t<std::is_arithmetic_v<detail::element_type_t<typename RHS::value_type>> &&
                                      std::is_same_v<typename RHS::value_type, typename LHS::value_type>>>
 auto operator!=(LHS lhs, RHS rhs) {
   return detail::relational_operation<detail::relational_operation_type::ne, LHS, RHS>(std::move(lhs), std::move(rhs));
 }
 
 template<typename LHS, typename RHS,
-         typename = std::enable_if_t<std::is_arithmetic_v<typename RHS::value_type> &&
+         typename = std::enable_if_t<std::is_arithmetic_v<detail::element_type_t<typename RHS::value_type>> &&
                                      std::is_same_v<typename RHS::value_type, typename LHS::value_type>>>
 auto operator>=(LHS lhs, RHS rhs) {
   return detail::relational_operation<detail::relational_operation_type::ge, LHS, RHS>(std::move(lhs), std::move(rhs));
 }
 
 template<typename LHS, typename RHS,
-         typename = std::enable_if_t<std::is_arithmetic_v<typename RHS::value_type> &&
+         typename = std::enable_if_t<std::is_arithmetic_v<detail::element_type_t<typename RHS::value_type>> &&
                                      std::is_same_v<typename RHS::value_type, typename LHS::value_type>>>
 auto operator>(LHS lhs, RHS rhs) {
   return detail::relational_operation<detail::relational_operation_type::gt, LHS, RHS>(std::move(lhs), std::move(rhs));
 }
 
 template<typename LHS, typename RHS,
-         typename = std::enable_if_t<std::is_arithmetic_v<typename RHS::value_type> &&
+         typename = std::enable_if_t<std::is_arithmetic_v<detail::element_type_t<typename RHS::value_type>> &&
                                      std::is_same_v<typename RHS::value_type, typename LHS::value_type>>>
 auto operator<=(LHS lhs, RHS rhs) {
   return detail::relational_operation<detail::relational_operation_type::le, LHS, RHS>(std::move(lhs), std::move(rhs));
 }
 
 template<typename LHS, typename RHS,
-         typename = std::enable_if_t<std::is_arithmetic_v<typename RHS::value_type> &&
+         typename = std::enable_if_t<std::is_arithmetic_v<detail::element_type_t<typename RHS::value_type>> &&
                                      std::is_same_v<typename RHS::value_type, typename LHS::value_type>>>
 auto operator<(LHS lhs, RHS rhs) {
   return detail::relational_operation<detail::relational_operation_type::lt, LHS, RHS>(std::move(lhs), std::move(rhs));
 }
 
+// && and || emit control flow and skip the evaluation of the right-hand side when possible. For cheap conditions the
+// bitwise operators &, | and ^, which also work for value<bool>, avoid branching.
+template<typename LHS, typename RHS,
+         typename = std::enable_if_t<std::is_same_v<typename LHS::value_type, bool> &&
+                                     std::is_same_v<typename RHS::value_type, bool>>>
+auto operator&&(LHS lhs, RHS rhs) {
+  return detail::logical_operation<detail::logical_operation_type::and_, LHS, RHS>(std::move(lhs), std::move(rhs));
+}
+
+template<typename LHS, typename RHS,
+         typename = std::enable_if_t<std::is_same_v<typename LHS::value_type, bool> &&
+                                     std::is_same_v<typename RHS::value_type, bool>>>
+auto operator||(LHS lhs, RHS rhs) {
+  return detail::logical_operation<detail::logical_operation_type::or_, LHS, RHS>(std::move(lhs), std::move(rhs));
+}
+
+template<typename Value,
+         typename = std::enable_if_t<std::is_same_v<detail::element_type_t<typename Value::value_type>, bool>>>
+auto operator!(Value v) {
+  return detail::logical_not_operation<Value>(std::move(v));
+}
+
 } // namespace codegen
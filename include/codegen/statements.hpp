@@ -22,6 +22,14 @@
 
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
 #include "codegen/module_builder.hpp"
 #include "codegen/utils.hpp"
 
@@ -82,9 +90,10 @@ void if_(Condition&& cnd, TrueBlock&& tb, FalseBlock&& fb) {
   mb.ir_builder_.SetInsertPoint(merge_block);
 }
 
-template<typename Condition, typename TrueBlock,
-         typename = std::enable_if_t<std::is_same_v<typename std::decay_t<Condition>::value_type, bool>>>
-void if_(Condition&& cnd, TrueBlock&& tb) {
+namespace detail {
+
+template<typename Condition, typename TrueBlock>
+void if_impl(Condition&& cnd, TrueBlock&& tb, llvm::MDNode* branch_weights) {
   auto& mb = *detail::current_builder;
 
   auto line_no = mb.source_code_.add_line(fmt::format("if ({}) {{", cnd));
@@ -93,7 +102,7 @@ void if_(Condition&& cnd, TrueBlock&& tb) {
   auto true_block = llvm::BasicBlock::Create(*mb.context_, "true_block", mb.function_);
   auto merge_block = llvm::BasicBlock::Create(*mb.context_, "merge_block");
 
-  mb.ir_builder_.CreateCondBr(cnd.eval(), true_block, merge_block);
+  mb.ir_builder_.CreateCondBr(cnd.eval(), true_block, merge_block, branch_weights);
 
   mb.ir_builder_.SetInsertPoint(true_block);
   mb.source_code_.enter_scope();
@@ -119,14 +128,154 @@ void if_(Condition&& cnd, TrueBlock&& tb) {
   mb.ir_builder_.SetInsertPoint(merge_block);
 }
 
-template<typename ReturnType, typename... Arguments, typename... Values>
-value<ReturnType> call(function_ref<ReturnType, Arguments...> const& fn, Values&&... args) {
-  static_assert((std::is_same_v<Arguments, typename std::decay_t<Values>::value_type> && ...));
+} // namespace detail
+
+template<typename Condition, typename TrueBlock,
+         typename = std::enable_if_t<std::is_same_v<typename std::decay_t<Condition>::value_type, bool>>>
+void if_(Condition&& cnd, TrueBlock&& tb) {
+  detail::if_impl(std::forward<Condition>(cnd), std::forward<TrueBlock>(tb), nullptr);
+}
+
+namespace detail {
+
+template<typename Constant, typename Block> struct switch_case {
+  static_assert(std::is_integral_v<Constant> && !std::is_same_v<Constant, bool>);
+  Constant value;
+  Block block;
+};
+
+template<typename Block> struct switch_default {
+  Block block;
+};
+
+template<typename Target, typename Source> bool is_representable_as(Source value) {
+  auto is_negative = [](auto v) {
+    if constexpr (std::is_signed_v<decltype(v)>) {
+      return v < 0;
+    } else {
+      return false;
+    }
+  };
+  auto converted = static_cast<Target>(value);
+  return static_cast<Source>(converted) == value && is_negative(converted) == is_negative(value);
+}
+
+template<typename> inline constexpr bool is_switch_default_v = false;
+template<typename Block> inline constexpr bool is_switch_default_v<switch_default<Block>> = true;
+
+} // namespace detail
+
+template<typename Constant, typename Block> auto case_(Constant value, Block&& blk) {
+  return detail::switch_case<Constant, std::decay_t<Block>>{value, std::forward<Block>(blk)};
+}
+
+template<typename Block> auto default_(Block&& blk) {
+  return detail::switch_default<std::decay_t<Block>>{std::forward<Block>(blk)};
+}
+
+// A multi-way branch emitted as LLVM switch, which the backend may lower to a jump table. Cases don't fall through
+// and break_() and continue_() refer to the enclosing loop. Case values must be distinct and representable in the
+// type of the switched value, otherwise std::invalid_argument is thrown before any code is emitted. The default case
+// is optional. For example:
+// switch_(opcode, case_(0, [&] { ... }), case_(1, [&] { ... }), default_([&] { ... }));
+template<typename Value, typename... Cases> void switch_(Value const& v, Cases const&... cases) {
+  using value_type = typename Value::value_type;
+  static_assert(std::is_integral_v<value_type> && !std::is_same_v<value_type, bool>);
+  constexpr auto default_count = (size_t(0) + ... + size_t(detail::is_switch_default_v<Cases>));
+  static_assert(default_count <= 1, "switch_ can have only one default case");
+
+  auto case_values = std::vector<value_type>{};
+  auto check_case = [&](auto const& c) {
+    if constexpr (!detail::is_switch_default_v<std::decay_t<decltype(c)>>) {
+      if (!detail::is_representable_as<value_type>(c.value)) {
+        throw std::invalid_argument("switch case value " + std::to_string(c.value) + " is out of range");
+      }
+      auto value = static_cast<value_type>(c.value);
+      if (std::find(case_values.begin(), case_values.end(), value) != case_values.end()) {
+        throw std::invalid_argument("duplicate switch case value " + std::to_string(c.value));
+      }
+      case_values.emplace_back(value);
+    }
+  };
+  (check_case(cases), ...);
 
   auto& mb = *detail::current_builder;
 
+  auto line_no = mb.source_code_.add_line(fmt::format("switch ({}) {{", v));
+  mb.ir_builder_.SetCurrentDebugLocation(llvm::DebugLoc::get(line_no, 1, mb.dbg_scope_));
+
+  auto merge_block = llvm::BasicBlock::Create(*mb.context_, "switch_merge");
+  auto default_block = default_count ? llvm::BasicBlock::Create(*mb.context_, "switch_default") : merge_block;
+
+  auto switch_inst = mb.ir_builder_.CreateSwitch(v.eval(), default_block, case_values.size());
+
+  mb.source_code_.enter_scope();
+  auto parent_scope = mb.dbg_scope_;
+
+  auto generate_case = [&](llvm::BasicBlock* block, std::string const& label, auto const& body) {
+    mb.function_->getBasicBlockList().push_back(block);
+    mb.ir_builder_.SetInsertPoint(block);
+
+    mb.source_code_.add_line(label);
+    mb.source_code_.enter_scope();
+    mb.dbg_scope_ = mb.dbg_builder_.createLexicalBlock(parent_scope, mb.dbg_file_, mb.source_code_.current_line(), 1);
+
+    assert(!mb.exited_block_);
+    body();
+    mb.source_code_.leave_scope();
+
+    mb.dbg_scope_ = parent_scope;
+
+    auto line_no = mb.source_code_.add_line("}");
+
+    if (!mb.exited_block_) {
+      mb.ir_builder_.SetCurrentDebugLocation(llvm::DebugLoc::get(line_no, 1, mb.dbg_scope_));
+      mb.ir_builder_.CreateBr(merge_block);
+    }
+    mb.exited_block_ = false;
+  };
+
+  auto generate = [&](auto const& c) {
+    if constexpr (detail::is_switch_default_v<std::decay_t<decltype(c)>>) {
+      generate_case(default_block, "default: {", c.block);
+    } else {
+      auto case_value = constant<value_type>(static_cast<value_type>(c.value));
+      auto case_constant = llvm::cast<llvm::ConstantInt>(case_value.eval());
+      assert(switch_inst->findCaseValue(case_constant) == switch_inst->case_default());
+      auto case_block = llvm::BasicBlock::Create(*mb.context_, "switch_case");
+      switch_inst->addCase(case_constant, case_block);
+      generate_case(case_block, fmt::format("case {}: {{", case_value), c.block);
+    }
+  };
+  (generate(cases), ...);
+
+  mb.source_code_.leave_scope();
+  mb.source_code_.add_line("}");
+
+  mb.function_->getBasicBlockList().push_back(merge_block);
+  mb.ir_builder_.SetInsertPoint(merge_block);
+}
+
+namespace detail {
+
+template<typename Type> inline constexpr bool is_function_pointer_v = false;
+template<typename ReturnType, typename... Arguments>
+inline constexpr bool is_function_pointer_v<ReturnType (*)(Arguments...)> = true;
+
+template<typename Type> struct function_pointer_traits;
+template<typename ReturnType, typename... Arguments> struct function_pointer_traits<ReturnType (*)(Arguments...)> {
+  using return_type = ReturnType;
+  template<typename... Values>
+  static constexpr bool accepts_v = (std::is_same_v<Arguments, typename std::decay_t<Values>::value_type> && ...);
+};
+
+template<typename... Values>
+llvm::CallInst* create_call(std::string const& prefix, std::string const& callee_name, llvm::Value* callee,
+                            Values&&... args) {
+  auto& mb = *current_builder;
+
   auto str = std::stringstream{};
-  str << fn.name() << "_ret = " << fn.name() << "(";
+  str << prefix << callee_name << "(";
   (void)(str << ... << fmt::format("{}, ", args));
   str << ");";
   auto line_no = mb.source_code_.add_line(str.str());
@@ -136,10 +285,103 @@ value<ReturnType> call(function_ref<ReturnType, Arguments...> const& fn, Values&
   auto values = std::vector<llvm::Value*>{};
   [[maybe_unused]] auto _ = {0, ((values.emplace_back(args.eval())), 0)...};
 
-  auto ret = mb.ir_builder_.CreateCall(fn, values);
+  return mb.ir_builder_.CreateCall(callee, values);
+}
+
+// musttail guarantees that the call doesn't grow the stack, the callee has to have the same signature and calling
+// convention as the caller.
+template<typename ReturnType> void create_tail_call(llvm::CallInst* call) {
+  auto& mb = *current_builder;
+  assert(call->getFunctionType() == mb.function_->getFunctionType());
+  assert(call->getCallingConv() == mb.function_->getCallingConv());
+  call->setTailCallKind(llvm::CallInst::TCK_MustTail);
+  mb.exited_block_ = true;
+  if constexpr (std::is_void_v<ReturnType>) {
+    mb.ir_builder_.CreateRetVoid();
+  } else {
+    mb.ir_builder_.CreateRet(call);
+  }
+}
+
+} // namespace detail
+
+template<typename ReturnType, typename... Arguments, typename... Values>
+value<ReturnType> call(function_ref<ReturnType, Arguments...> const& fn, Values&&... args) {
+  static_assert((std::is_same_v<Arguments, typename std::decay_t<Values>::value_type> && ...));
+  auto ret = detail::create_call(fn.name() + "_ret = ", fn.name(), fn, std::forward<Values>(args)...);
+  ret->setCallingConv(static_cast<llvm::Function*>(fn)->getCallingConv());
   return value<ReturnType>{ret, fmt::format("{}_ret", fn.name())};
 }
 
+// Calls a function through a pointer, e.g. one loaded from a table of handlers. The callee has to use the C calling
+// convention.
+template<typename FunctionPointer, typename... Values,
+         typename = std::enable_if_t<detail::is_function_pointer_v<typename FunctionPointer::value_type>>>
+auto call(FunctionPointer const& fn, Values&&... args) {
+  using traits = detail::function_pointer_traits<typename FunctionPointer::value_type>;
+  static_assert(traits::template accepts_v<Values...>);
+  using return_type = typename traits::return_type;
+  auto name = fmt::format("val{}", detail::id_counter++);
+  auto ret = detail::create_call(name + " = ", fmt::format("(*{})", fn), fn.eval(), std::forward<Values>(args)...);
+  return value<return_type>{ret, name};
+}
+
+// Returns the result of calling the function without growing the stack, which allows long chains of calls, e.g. in
+// threaded-code interpreters. The callee has to have the same signature as the current function.
+template<typename ReturnType, typename... Arguments, typename... Values>
+void tail_call(function_ref<ReturnType, Arguments...> const& fn, Values&&... args) {
+  static_assert((std::is_same_v<Arguments, typename std::decay_t<Values>::value_type> && ...));
+  auto ret = detail::create_call("return musttail ", fn.name(), fn, std::forward<Values>(args)...);
+  ret->setCallingConv(static_cast<llvm::Function*>(fn)->getCallingConv());
+  detail::create_tail_call<ReturnType>(ret);
+}
+
+template<typename FunctionPointer, typename... Values,
+         typename = std::enable_if_t<detail::is_function_pointer_v<typename FunctionPointer::value_type>>>
+void tail_call(FunctionPointer const& fn, Values&&... args) {
+  using traits = detail::function_pointer_traits<typename FunctionPointer::value_type>;
+  static_assert(traits::template accepts_v<Values...>);
+  auto ret =
+      detail::create_call("return musttail ", fmt::format("(*{})", fn), fn.eval(), std::forward<Values>(args)...);
+  detail::create_tail_call<typename traits::return_type>(ret);
+}
+
+// Memory accesses annotated with one of the scopes created by a single call to make_alias_scopes() are assumed not
+// to alias accesses annotated with any other scope from that set, e.g. if they refer to distinct buffers.
+class alias_scope {
+  llvm::MDNode* scope_{};
+  llvm::MDNode* noalias_{};
+
+  template<size_t Count> friend std::array<alias_scope, Count> make_alias_scopes(std::string const&);
+
+public:
+  void apply(llvm::Instruction* inst) const {
+    inst->setMetadata(llvm::LLVMContext::MD_alias_scope, scope_);
+    inst->setMetadata(llvm::LLVMContext::MD_noalias, noalias_);
+  }
+};
+
+template<size_t Count> std::array<alias_scope, Count> make_alias_scopes(std::string const& name) {
+  static_assert(Count > 1);
+  auto& mb = *detail::current_builder;
+  auto md = llvm::MDBuilder(*mb.context_);
+  auto domain = md.createAnonymousAliasScopeDomain(name);
+
+  auto scopes = std::array<llvm::Metadata*, Count>{};
+  for (auto i = 0u; i < Count; i++) { scopes[i] = md.createAnonymousAliasScope(domain, fmt::format("{}.{}", name, i)); }
+
+  auto alias_scopes = std::array<alias_scope, Count>{};
+  for (auto i = 0u; i < Count; i++) {
+    auto others = std::vector<llvm::Metadata*>{};
+    for (auto j = 0u; j < Count; j++) {
+      if (i != j) { others.emplace_back(scopes[j]); }
+    }
+    alias_scopes[i].scope_ = llvm::MDNode::get(*mb.context_, {scopes[i]});
+    alias_scopes[i].noalias_ = llvm::MDNode::get(*mb.context_, others);
+  }
+  return alias_scopes;
+}
+
 template<typename Pointer, typename = std::enable_if_t<std::is_pointer_v<typename std::decay_t<Pointer>::value_type>>>
 auto load(Pointer ptr) {
   using value_type = std::remove_cv_t<std::remove_pointer_t<typename std::decay_t<Pointer>::value_type>>;
@@ -150,6 +392,8 @@ auto load(Pointer ptr) {
   auto line_no = mb.source_code_.add_line(fmt::format("{} = *{}", id, ptr));
   mb.ir_builder_.SetCurrentDebugLocation(llvm::DebugLoc::get(line_no, 1, mb.dbg_scope_));
   auto v = mb.ir_builder_.CreateAlignedLoad(ptr.eval(), detail::type<value_type>::alignment);
+  v->setMetadata(llvm::LLVMContext::MD_tbaa, detail::get_tbaa_access_tag<value_type>());
+  if (mb.access_group_) { v->setMetadata(llvm::LLVMContext::MD_access_group, mb.access_group_); }
 
   auto dbg_value =
       mb.dbg_builder_.createAutoVariable(mb.dbg_scope_, id, mb.dbg_file_, line_no, detail::type<value_type>::dbg());
@@ -160,6 +404,61 @@ auto load(Pointer ptr) {
   return value<value_type>{v, id};
 }
 
+template<typename Pointer, typename = std::enable_if_t<std::is_pointer_v<typename std::decay_t<Pointer>::value_type>>>
+auto load(Pointer ptr, alias_scope const& scope) {
+  auto v = load(std::move(ptr));
+  scope.apply(llvm::cast<llvm::Instruction>(v.eval()));
+  return v;
+}
+
+// Evaluates an expression and returns its result as a value. Expressions emit their IR every time they are used, so
+// the ones that are needed more than once should be evaluated only once using let.
+template<typename Expression> auto let(Expression const& expr) {
+  using value_type = typename Expression::value_type;
+  auto& mb = *detail::current_builder;
+
+  auto id = fmt::format("val{}", detail::id_counter++);
+
+  auto line_no = mb.source_code_.add_line(fmt::format("{} = {};", id, expr));
+  mb.ir_builder_.SetCurrentDebugLocation(llvm::DebugLoc::get(line_no, 1, mb.dbg_scope_));
+  auto v = expr.eval();
+
+  auto dbg_value =
+      mb.dbg_builder_.createAutoVariable(mb.dbg_scope_, id, mb.dbg_file_, line_no, detail::type<value_type>::dbg());
+  mb.dbg_builder_.insertDbgValueIntrinsic(v, dbg_value, mb.dbg_builder_.createExpression(),
+                                          llvm::DebugLoc::get(line_no, 1, mb.dbg_scope_),
+                                          mb.ir_builder_.GetInsertBlock());
+
+  return value<value_type>{v, id};
+}
+
+// Copies host data into the module as a private constant, e.g. a small table known only at runtime. Unlike a pointer
+// to the host data, the copy lets the optimiser fold loads from it. Later changes to the host data are not visible.
+template<typename Type> value<Type const*> freeze(Type const* data, size_t size = 1) {
+  auto& mb = *detail::current_builder;
+  auto id = fmt::format("frozen{}", detail::id_counter++);
+  llvm::GlobalVariable* gv = mb.create_constant_array(id, data, size);
+  gv->setLinkage(llvm::GlobalValue::PrivateLinkage);
+  gv->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+  return value<Type const*>{detail::get_first_element(gv), id};
+}
+
+namespace detail {
+
+template<typename Value, typename Pointer> llvm::StoreInst* store_impl(Value const& v, Pointer const& ptr) {
+  using value_type = std::remove_pointer_t<typename Pointer::value_type>;
+  auto& mb = *current_builder;
+
+  auto line_no = mb.source_code_.add_line(fmt::format("*{} = {}", ptr, v));
+  mb.ir_builder_.SetCurrentDebugLocation(llvm::DebugLoc::get(line_no, 1, mb.dbg_scope_));
+  auto store = mb.ir_builder_.CreateAlignedStore(v.eval(), ptr.eval(), type<value_type>::alignment);
+  store->setMetadata(llvm::LLVMContext::MD_tbaa, get_tbaa_access_tag<value_type>());
+  if (mb.access_group_) { store->setMetadata(llvm::LLVMContext::MD_access_group, mb.access_group_); }
+  return store;
+}
+
+} // namespace detail
+
 template<
     typename Value, typename Pointer,
     typename = std::enable_if_t<std::is_pointer_v<typename std::decay_t<Pointer>::value_type> &&
@@ -167,12 +466,17 @@ template<
                                 std::is_same_v<typename std::decay_t<Value>::value_type,
                                                std::remove_pointer_t<typename std::decay_t<Pointer>::value_type>>>>
 void store(Value v, Pointer ptr) {
-  using value_type = std::remove_pointer_t<typename std::decay_t<Pointer>::value_type>;
-  auto& mb = *detail::current_builder;
+  detail::store_impl(v, ptr);
+}
 
-  auto line_no = mb.source_code_.add_line(fmt::format("*{} = {}", ptr, v));
-  mb.ir_builder_.SetCurrentDebugLocation(llvm::DebugLoc::get(line_no, 1, mb.dbg_scope_));
-  mb.ir_builder_.CreateAlignedStore(v.eval(), ptr.eval(), detail::type<value_type>::alignment);
+template<
+    typename Value, typename Pointer,
+    typename = std::enable_if_t<std::is_pointer_v<typename std::decay_t<Pointer>::value_type> &&
+                                !std::is_const_v<std::remove_pointer_t<typename std::decay_t<Pointer>::value_type>> &&
+                                std::is_same_v<typename std::decay_t<Value>::value_type,
+                                               std::remove_pointer_t<typename std::decay_t<Pointer>::value_type>>>>
+void store(Value v, Pointer ptr, alias_scope const& scope) {
+  scope.apply(detail::store_impl(v, ptr));
 }
 
 template<typename ConditionFn, typename Body,
@@ -182,8 +486,6 @@ void while_(ConditionFn cnd_fn, Body bdy) {
 
   auto line_no = mb.source_code_.current_line() + 1;
   mb.ir_builder_.SetCurrentDebugLocation(llvm::DebugLoc::get(line_no, 1, mb.dbg_scope_));
-  auto cnd = cnd_fn();
-  mb.source_code_.add_line(fmt::format("while ({}) {{", cnd));
 
   auto while_continue = llvm::BasicBlock::Create(*mb.context_, "while_continue", mb.function_);
   auto while_iteration = llvm::BasicBlock::Create(*mb.context_, "while_iteration");
@@ -194,7 +496,9 @@ void while_(ConditionFn cnd_fn, Body bdy) {
   mb.ir_builder_.CreateBr(while_continue);
   mb.ir_builder_.SetInsertPoint(while_continue);
 
-  mb.ir_builder_.CreateCondBr(cnd_fn().eval(), while_iteration, while_break);
+  auto cnd = cnd_fn();
+  mb.source_code_.add_line(fmt::format("while ({}) {{", cnd));
+  mb.ir_builder_.CreateCondBr(cnd.eval(), while_iteration, while_break);
 
   mb.source_code_.enter_scope();
 
@@ -224,7 +528,197 @@ void while_(ConditionFn cnd_fn, Body bdy) {
   mb.current_loop_ = parent_loop;
 }
 
+// Hints passed to the loop optimisations in the llvm.loop metadata. They override LLVM heuristics, e.g.
+// loop_hints{}.vectorize_width(8).interleave_count(2).
+class loop_hints {
+  std::vector<std::pair<std::string, std::optional<int32_t>>> hints_;
+  bool parallel_accesses_ = false;
+
+public:
+  loop_hints& vectorize(bool enable) {
+    hints_.emplace_back("llvm.loop.vectorize.enable", int32_t(enable));
+    return *this;
+  }
+  loop_hints& vectorize_width(int32_t width) {
+    hints_.emplace_back("llvm.loop.vectorize.width", width);
+    return *this;
+  }
+  loop_hints& interleave_count(int32_t count) {
+    hints_.emplace_back("llvm.loop.interleave.count", count);
+    return *this;
+  }
+  loop_hints& unroll_count(int32_t count) {
+    hints_.emplace_back("llvm.loop.unroll.count", count);
+    return *this;
+  }
+  loop_hints& unroll_full() {
+    hints_.emplace_back("llvm.loop.unroll.full", std::nullopt);
+    return *this;
+  }
+  loop_hints& unroll_disable() {
+    hints_.emplace_back("llvm.loop.unroll.disable", std::nullopt);
+    return *this;
+  }
+  // Iterations of the loop don't depend on each other, so memory accesses done by load and store in the loop body can
+  // be reordered freely, e.g. there is no need for runtime alias checks before vectorising the loop.
+  loop_hints& parallel_accesses() {
+    parallel_accesses_ = true;
+    return *this;
+  }
+
+  bool has_parallel_accesses() const { return parallel_accesses_; }
+
+  llvm::MDNode* get(llvm::LLVMContext& context, llvm::MDNode* access_group) const {
+    if (hints_.empty() && !access_group) { return nullptr; }
+    auto operands = std::vector<llvm::Metadata*>{nullptr};
+    for (auto& [name, value] : hints_) {
+      auto hint = std::vector<llvm::Metadata*>{llvm::MDString::get(context, name)};
+      if (value) {
+        auto type = name == "llvm.loop.vectorize.enable" ? llvm::Type::getInt1Ty(context)
+                                                          : llvm::Type::getInt32Ty(context);
+        hint.emplace_back(llvm::ConstantAsMetadata::get(llvm::ConstantInt::get(type, *value)));
+      }
+      operands.emplace_back(llvm::MDNode::get(context, hint));
+    }
+    if (access_group) {
+      operands.emplace_back(
+          llvm::MDNode::get(context, {llvm::MDString::get(context, "llvm.loop.parallel_accesses"), access_group}));
+    }
+    auto loop_id = llvm::MDNode::getDistinct(context, operands);
+    loop_id->replaceOperandWith(0, loop_id);
+    return loop_id;
+  }
+};
+
+namespace detail {
+
+// Accesses in the body of nested parallel loops belong to the access groups of all of them. A single group is
+// attached directly, more are attached as a list of groups.
+inline llvm::MDNode* add_access_group(llvm::LLVMContext& context, llvm::MDNode* groups, llvm::MDNode* group) {
+  if (!group) { return groups; }
+  if (!groups) { return group; }
+  auto operands = std::vector<llvm::Metadata*>{};
+  if (groups->getNumOperands() == 0) {
+    operands.emplace_back(groups);
+  } else {
+    operands.insert(operands.end(), groups->op_begin(), groups->op_end());
+  }
+  operands.emplace_back(group);
+  return llvm::MDNode::get(context, operands);
+}
+
+} // namespace detail
+
+// A counted loop: for (i = begin; i < end; i += step) body(i). begin, end and step are evaluated once, before the
+// loop. The induction variable is an SSA value, which LLVM loop optimisations understand without the need to
+// promote a variable to a register first. break_() and continue_() can be used in the body.
+template<typename Begin, typename End, typename Step, typename Body>
+void for_(Begin const& begin, End const& end, Step const& step, Body&& bdy, loop_hints const& hints = {}) {
+  using value_type = typename Begin::value_type;
+  static_assert(std::is_integral_v<value_type> && !std::is_same_v<value_type, bool>);
+  static_assert(std::is_same_v<value_type, typename End::value_type>);
+  static_assert(std::is_same_v<value_type, typename Step::value_type>);
+
+  auto& mb = *detail::current_builder;
+  auto& irb = mb.ir_builder_;
+
+  auto id = fmt::format("idx{}", detail::id_counter++);
+  auto line_no = mb.source_code_.add_line(
+      fmt::format("for ({} = {}; {} < {}; {} += {}) {{", id, begin, id, end, id, step));
+  irb.SetCurrentDebugLocation(llvm::DebugLoc::get(line_no, 1, mb.dbg_scope_));
+
+  auto begin_value = begin.eval();
+  auto end_value = end.eval();
+  auto step_value = step.eval();
+
+  auto for_header = llvm::BasicBlock::Create(*mb.context_, "for_header", mb.function_);
+  auto for_iteration = llvm::BasicBlock::Create(*mb.context_, "for_iteration");
+  auto for_continue = llvm::BasicBlock::Create(*mb.context_, "for_continue");
+  auto for_break = llvm::BasicBlock::Create(*mb.context_, "for_break");
+
+  auto preheader = irb.GetInsertBlock();
+  irb.CreateBr(for_header);
+  irb.SetInsertPoint(for_header);
+  auto induction = irb.CreatePHI(detail::type<value_type>::llvm(), 2, id);
+  induction->addIncoming(begin_value, preheader);
+  auto cnd = std::is_signed_v<value_type> ? irb.CreateICmpSLT(induction, end_value)
+                                          : irb.CreateICmpULT(induction, end_value);
+  irb.CreateCondBr(cnd, for_iteration, for_break);
+
+  auto parent_loop = std::exchange(mb.current_loop_, module_builder::loop{for_continue, for_break});
+  auto access_group = hints.has_parallel_accesses() ? llvm::MDNode::getDistinct(*mb.context_, {}) : nullptr;
+  auto parent_access_group =
+      std::exchange(mb.access_group_, detail::add_access_group(*mb.context_, mb.access_group_, access_group));
+
+  mb.source_code_.enter_scope();
+
+  auto scope = mb.dbg_builder_.createLexicalBlock(mb.dbg_scope_, mb.dbg_file_, mb.source_code_.current_line(), 1);
+  auto parent_scope = std::exchange(mb.dbg_scope_, scope);
+
+  mb.function_->getBasicBlockList().push_back(for_iteration);
+  irb.SetInsertPoint(for_iteration);
+
+  auto dbg_induction =
+      mb.dbg_builder_.createAutoVariable(mb.dbg_scope_, id, mb.dbg_file_, line_no, detail::type<value_type>::dbg());
+  mb.dbg_builder_.insertDbgValueIntrinsic(induction, dbg_induction, mb.dbg_builder_.createExpression(),
+                                          llvm::DebugLoc::get(line_no, 1, mb.dbg_scope_), for_iteration);
+
+  assert(!mb.exited_block_);
+  bdy(value<value_type>{induction, id});
+
+  mb.dbg_scope_ = parent_scope;
+
+  mb.source_code_.leave_scope();
+  line_no = mb.source_code_.add_line("}");
+  irb.SetCurrentDebugLocation(llvm::DebugLoc::get(line_no, 1, mb.dbg_scope_));
+
+  if (!mb.exited_block_) { irb.CreateBr(for_continue); }
+  mb.exited_block_ = false;
+
+  mb.function_->getBasicBlockList().push_back(for_continue);
+  irb.SetInsertPoint(for_continue);
+  induction->addIncoming(irb.CreateAdd(induction, step_value), for_continue);
+  auto latch = irb.CreateBr(for_header);
+  if (auto loop_id = hints.get(*mb.context_, access_group)) { latch->setMetadata(llvm::LLVMContext::MD_loop, loop_id); }
+
+  mb.function_->getBasicBlockList().push_back(for_break);
+  irb.SetInsertPoint(for_break);
+
+  mb.access_group_ = parent_access_group;
+  mb.current_loop_ = parent_loop;
+}
+
+// Generates the body with the given fast-math flags, which replace the ones of the enclosing scope or function.
+// Passing fast_math_flags{} makes the operations in the body strict again.
+template<typename Body> void with_fast_math(fast_math_flags const& flags, Body&& bdy) {
+  auto& mb = *detail::current_builder;
+
+  mb.source_code_.add_line(fmt::format("fast_math({}) {{", flags));
+  mb.source_code_.enter_scope();
+
+  auto guard = llvm::IRBuilderBase::FastMathFlagGuard(mb.ir_builder_);
+  mb.ir_builder_.setFastMathFlags(flags.get());
+  bdy();
+
+  mb.source_code_.leave_scope();
+  mb.source_code_.add_line("}");
+}
+
 void break_();
 void continue_();
 
+// Stores the value so that the caller can read it and suspends the generator, see module_builder::create_generator().
+template<typename Value> void yield_(Value const& v) {
+  using value_type = typename Value::value_type;
+  auto& mb = *detail::current_builder;
+  assert(mb.current_coroutine_.promise_);
+  assert(mb.current_coroutine_.promise_->getAllocatedType() == detail::type<value_type>::llvm());
+
+  auto line_no = mb.source_code_.add_line(fmt::format("yield {};", v));
+  mb.ir_builder_.SetCurrentDebugLocation(llvm::DebugLoc::get(line_no, 1, mb.dbg_scope_));
+
+  mb.ir_builder_.CreateAlignedStore(v.eval(), mb.current_coroutine_.promise_, detail::type<value_type>::alignment);
+  detail::suspend_coroutine(false);
+}
+
 } // namespace codegen
@@ -66,4 +66,109 @@ public:
   }
 };
 
+namespace detail {
+
+template<typename Type, size_t Size> class array_storage {
+  llvm::AllocaInst* variable_;
+  std::string name_;
+
+  template<typename Index> llvm::Value* element_pointer(Index const& idx) const {
+    using index_type = typename Index::value_type;
+    static_assert(std::is_integral_v<index_type>);
+
+    auto& mb = *current_builder;
+    auto index = idx.eval();
+    if constexpr (sizeof(index_type) < sizeof(uint64_t)) {
+      if constexpr (std::is_unsigned_v<index_type>) {
+        index = mb.ir_builder_.CreateZExt(index, type<uint64_t>::llvm());
+      } else {
+        index = mb.ir_builder_.CreateSExt(index, type<int64_t>::llvm());
+      }
+    }
+    return mb.ir_builder_.CreateInBoundsGEP(variable_, {get_constant<uint64_t>(0), index});
+  }
+
+protected:
+  array_storage(std::string const& n, std::string const& declared_size, size_t alignment) : name_(n) {
+    static_assert(!std::is_const_v<Type>);
+    static_assert(!std::is_volatile_v<Type>);
+    static_assert(Size > 0);
+
+    auto& mb = *current_builder;
+    auto array_type = llvm::ArrayType::get(type<Type>::llvm(), Size);
+
+    auto alloca_builder = llvm::IRBuilder<>(&mb.function_->getEntryBlock(), mb.function_->getEntryBlock().begin());
+    variable_ = alloca_builder.CreateAlloca(array_type, nullptr, name_);
+    variable_->setAlignment(std::max(alignment, type<Type>::alignment));
+
+    auto line_no = mb.source_code_.add_line(fmt::format("{} {}[{}];", type<Type>::name(), name_, declared_size));
+    mb.ir_builder_.SetCurrentDebugLocation(llvm::DebugLoc::get(line_no, 1, mb.dbg_scope_));
+    mb.ir_builder_.CreateLifetimeStart(variable_);
+
+    auto dbg_type = mb.dbg_builder_.createArrayType(
+        sizeof(Type) * Size * 8, variable_->getAlignment() * 8, type<Type>::dbg(),
+        mb.dbg_builder_.getOrCreateArray({mb.dbg_builder_.getOrCreateSubrange(0, Size)}));
+    auto dbg_variable = mb.dbg_builder_.createAutoVariable(mb.dbg_scope_, name_, mb.dbg_file_, line_no, dbg_type);
+    mb.dbg_builder_.insertDeclare(variable_, dbg_variable, mb.dbg_builder_.createExpression(),
+                                  llvm::DebugLoc::get(line_no, 1, mb.dbg_scope_), mb.ir_builder_.GetInsertBlock());
+  }
+
+  ~array_storage() {
+    auto& mb = *current_builder;
+    if (!mb.exited_block_) { mb.ir_builder_.CreateLifetimeEnd(variable_); }
+  }
+
+public:
+  array_storage(array_storage const&) = delete;
+  array_storage(array_storage&&) = delete;
+
+  value<Type*> data() const {
+    auto ptr = current_builder->ir_builder_.CreateConstInBoundsGEP2_64(variable_, 0, 0);
+    return value<Type*>{ptr, name_};
+  }
+
+  template<typename Index> value<Type> get(Index const& idx) const {
+    auto v = current_builder->ir_builder_.CreateAlignedLoad(element_pointer(idx), type<Type>::alignment);
+    return value<Type>{v, fmt::format("{}[{}]", name_, idx)};
+  }
+
+  template<typename Index, typename Value> void set(Index const& idx, Value const& v) {
+    static_assert(std::is_same_v<Type, typename Value::value_type>);
+    auto& mb = *current_builder;
+    auto line_no = mb.source_code_.add_line(fmt::format("{}[{}] = {};", name_, idx, v));
+    mb.ir_builder_.SetCurrentDebugLocation(llvm::DebugLoc::get(line_no, 1, mb.dbg_scope_));
+    mb.ir_builder_.CreateAlignedStore(v.eval(), element_pointer(idx), type<Type>::alignment);
+  }
+};
+
+} // namespace detail
+
+// Fixed-size array allocated on the stack of the generated function.
+template<typename Type, size_t Size> class array_variable : public detail::array_storage<Type, Size> {
+public:
+  explicit array_variable(std::string const& n, size_t alignment = detail::type<Type>::alignment)
+      : detail::array_storage<Type, Size>(n, std::to_string(Size), alignment) {}
+};
+
+// Stack buffer which size is known only at run-time, but is guaranteed not to exceed MaxSize. The storage for
+// MaxSize elements is reserved in the entry block, so that no dynamic stack allocation is needed. The size isn't
+// checked, it is up to the caller to ensure that it is at most MaxSize.
+template<typename Type, size_t MaxSize, typename SizeType = uint64_t>
+class buffer_variable : public detail::array_storage<Type, MaxSize> {
+  value<SizeType> size_;
+
+public:
+  static_assert(std::is_integral_v<SizeType>);
+
+  template<typename Size>
+  explicit buffer_variable(std::string const& n, Size const& sz, size_t alignment = detail::type<Type>::alignment)
+      : detail::array_storage<Type, MaxSize>(n, fmt::format("{}", sz), alignment),
+        size_(sz.eval(), fmt::format("{}", sz)) {
+    static_assert(std::is_same_v<SizeType, typename Size::value_type>);
+  }
+
+  // The run-time size of the buffer. Precondition: size() <= MaxSize, accesses past MaxSize elements are undefined.
+  value<SizeType> size() const { return size_; }
+};
+
 } // namespace codegen
@@ -0,0 +1,417 @@
+/*
+ * Copyright © 2019 Paweł Dziepak
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "codegen/module_builder.hpp"
+#include "codegen/utils.hpp"
+
+namespace codegen {
+
+namespace detail {
+
+template<typename Value, size_t Size> class broadcast_impl {
+  Value value_;
+
+  static_assert(std::is_arithmetic_v<typename Value::value_type>);
+
+public:
+  using value_type = vec<typename Value::value_type, Size>;
+
+  explicit broadcast_impl(Value v) : value_(std::move(v)) {}
+
+  llvm::Value* eval() const { return current_builder->ir_builder_.CreateVectorSplat(Size, value_.eval()); }
+
+  friend std::ostream& operator<<(std::ostream& os, broadcast_impl const& bi) {
+    return os << "broadcast<" << Size << ">(" << bi.value_ << ")";
+  }
+};
+
+template<typename Vector, typename Index> class extract_impl {
+  Vector vector_;
+  Index index_;
+
+  static_assert(std::is_integral_v<typename Index::value_type>);
+
+public:
+  using value_type = element_type_t<typename Vector::value_type>;
+  static_assert(vector_size_v<typename Vector::value_type> > 1);
+
+  extract_impl(Vector v, Index idx) : vector_(std::move(v)), index_(std::move(idx)) {}
+
+  llvm::Value* eval() const { return current_builder->ir_builder_.CreateExtractElement(vector_.eval(), index_.eval()); }
+
+  friend std::ostream& operator<<(std::ostream& os, extract_impl const& ei) {
+    return os << ei.vector_ << '[' << ei.index_ << ']';
+  }
+};
+
+template<typename Vector, typename Index, typename Element> class insert_impl {
+  Vector vector_;
+  Index index_;
+  Element element_;
+
+  static_assert(std::is_integral_v<typename Index::value_type>);
+  static_assert(std::is_same_v<element_type_t<typename Vector::value_type>, typename Element::value_type>);
+
+public:
+  using value_type = typename Vector::value_type;
+  static_assert(vector_size_v<value_type> > 1);
+
+  insert_impl(Vector v, Index idx, Element e) : vector_(std::move(v)), index_(std::move(idx)), element_(std::move(e)) {}
+
+  llvm::Value* eval() const {
+    return current_builder->ir_builder_.CreateInsertElement(vector_.eval(), element_.eval(), index_.eval());
+  }
+
+  friend std::ostream& operator<<(std::ostream& os, insert_impl const& ii) {
+    return os << "insert(" << ii.vector_ << ", " << ii.index_ << ", " << ii.element_ << ")";
+  }
+};
+
+template<typename LHS, typename RHS, unsigned... Indices> class shuffle_impl {
+  LHS lhs_;
+  RHS rhs_;
+
+  using element_type = element_type_t<typename LHS::value_type>;
+
+  static_assert(std::is_same_v<typename LHS::value_type, typename RHS::value_type>);
+  static_assert(((Indices < 2 * vector_size_v<typename LHS::value_type>) && ...));
+
+public:
+  using value_type = vec<element_type, sizeof...(Indices)>;
+
+  shuffle_impl(LHS lhs, RHS rhs) : lhs_(std::move(lhs)), rhs_(std::move(rhs)) {}
+
+  llvm::Value* eval() const {
+    return current_builder->ir_builder_.CreateShuffleVector(lhs_.eval(), rhs_.eval(), {uint32_t(Indices)...});
+  }
+
+  friend std::ostream& operator<<(std::ostream& os, shuffle_impl const& si) {
+    os << "shuffle<";
+    auto first = true;
+    (void)((os << (std::exchange(first, false) ? "" : ", ") << Indices), ...);
+    return os << ">(" << si.lhs_ << ", " << si.rhs_ << ")";
+  }
+};
+
+template<typename Vector> class undef_vector {
+public:
+  using value_type = Vector;
+
+  llvm::Value* eval() const { return llvm::UndefValue::get(type<Vector>::llvm()); }
+
+  friend std::ostream& operator<<(std::ostream& os, undef_vector const&) { return os << "undef"; }
+};
+
+enum class reduction_operation_type {
+  add,
+  mul,
+  and_,
+  or_,
+  xor_,
+  min,
+  max,
+};
+
+template<reduction_operation_type Op, typename Vector> class reduction_operation {
+  Vector vector_;
+
+  static_assert(vector_size_v<typename Vector::value_type> > 1);
+
+public:
+  using value_type = element_type_t<typename Vector::value_type>;
+
+  explicit reduction_operation(Vector v) : vector_(std::move(v)) {}
+
+  llvm::Value* eval() const {
+    auto& mb = *current_builder;
+    if constexpr (std::is_integral_v<value_type>) {
+      switch (Op) {
+      case reduction_operation_type::add: return mb.ir_builder_.CreateAddReduce(vector_.eval());
+      case reduction_operation_type::mul: return mb.ir_builder_.CreateMulReduce(vector_.eval());
+      case reduction_operation_type::and_: return mb.ir_builder_.CreateAndReduce(vector_.eval());
+      case reduction_operation_type::or_: return mb.ir_builder_.CreateOrReduce(vector_.eval());
+      case reduction_operation_type::xor_: return mb.ir_builder_.CreateXorReduce(vector_.eval());
+      case reduction_operation_type::min:
+        return mb.ir_builder_.CreateIntMinReduce(vector_.eval(), std::is_signed_v<value_type>);
+      case reduction_operation_type::max:
+        return mb.ir_builder_.CreateIntMaxReduce(vector_.eval(), std::is_signed_v<value_type>);
+      }
+    } else {
+      switch (Op) {
+      case reduction_operation_type::add:
+        return mb.ir_builder_.CreateFAddReduce(get_constant<value_type>(0), vector_.eval());
+      case reduction_operation_type::mul:
+        return mb.ir_builder_.CreateFMulReduce(get_constant<value_type>(1), vector_.eval());
+      case reduction_operation_type::min: return mb.ir_builder_.CreateFPMinReduce(vector_.eval());
+      case reduction_operation_type::max: return mb.ir_builder_.CreateFPMaxReduce(vector_.eval());
+      case reduction_operation_type::and_: [[fallthrough]];
+      case reduction_operation_type::or_: [[fallthrough]];
+      case reduction_operation_type::xor_: abort();
+      }
+    }
+    abort();
+  }
+
+  friend std::ostream& operator<<(std::ostream& os, reduction_operation const& ro) {
+    auto name = [] {
+      switch (Op) {
+      case reduction_operation_type::add: return "reduce_add";
+      case reduction_operation_type::mul: return "reduce_mul";
+      case reduction_operation_type::and_: return "reduce_and";
+      case reduction_operation_type::or_: return "reduce_or";
+      case reduction_operation_type::xor_: return "reduce_xor";
+      case reduction_operation_type::min: return "reduce_min";
+      case reduction_operation_type::max: return "reduce_max";
+      }
+      abort();
+    }();
+    return os << name << '(' << ro.vector_ << ')';
+  }
+};
+
+template<typename Pointer, typename Mask, typename PassThru> class masked_load_impl {
+  Pointer pointer_;
+  Mask mask_;
+  PassThru pass_thru_;
+
+  using element_type = std::remove_cv_t<std::remove_pointer_t<typename Pointer::value_type>>;
+
+public:
+  using value_type = vec<element_type, vector_size_v<typename Mask::value_type>>;
+  static_assert(std::is_same_v<typename Mask::value_type, rebind_element_t<value_type, bool>>);
+  static_assert(std::is_same_v<typename PassThru::value_type, value_type>);
+
+  masked_load_impl(Pointer ptr, Mask m, PassThru pt)
+      : pointer_(std::move(ptr)), mask_(std::move(m)), pass_thru_(std::move(pt)) {}
+
+  llvm::Value* eval() const {
+    auto& mb = *current_builder;
+    auto ptr = mb.ir_builder_.CreateBitCast(pointer_.eval(), type<value_type*>::llvm());
+    return mb.ir_builder_.CreateMaskedLoad(ptr, type<element_type>::alignment, mask_.eval(), pass_thru_.eval());
+  }
+
+  friend std::ostream& operator<<(std::ostream& os, masked_load_impl const& mli) {
+    return os << "masked_load(" << mli.pointer_ << ", " << mli.mask_ << ", " << mli.pass_thru_ << ")";
+  }
+};
+
+template<typename Pointer, typename Indices> llvm::Value* vector_gep(Pointer const& ptr, Indices const& idx) {
+  using index_type = typename Indices::value_type;
+  constexpr auto size = vector_size_v<index_type>;
+  static_assert(std::is_integral_v<element_type_t<index_type>>);
+
+  auto& mb = *current_builder;
+  auto indices = idx.eval();
+  if constexpr (sizeof(element_type_t<index_type>) < sizeof(uint64_t)) {
+    if constexpr (std::is_unsigned_v<element_type_t<index_type>>) {
+      indices = mb.ir_builder_.CreateZExt(indices, type<vec<uint64_t, size>>::llvm());
+    } else {
+      indices = mb.ir_builder_.CreateSExt(indices, type<vec<int64_t, size>>::llvm());
+    }
+  }
+  return mb.ir_builder_.CreateInBoundsGEP(ptr.eval(), indices);
+}
+
+template<typename Pointer, typename Indices, typename Mask, typename PassThru> class gather_impl {
+  Pointer pointer_;
+  Indices indices_;
+  Mask mask_;
+  PassThru pass_thru_;
+
+  using element_type = std::remove_cv_t<std::remove_pointer_t<typename Pointer::value_type>>;
+
+public:
+  using value_type = vec<element_type, vector_size_v<typename Indices::value_type>>;
+  static_assert(std::is_same_v<typename Mask::value_type, rebind_element_t<value_type, bool>>);
+  static_assert(std::is_same_v<typename PassThru::value_type, value_type>);
+
+  gather_impl(Pointer ptr, Indices idx, Mask m, PassThru pt)
+      : pointer_(std::move(ptr)), indices_(std::move(idx)), mask_(std::move(m)), pass_thru_(std::move(pt)) {}
+
+  llvm::Value* eval() const {
+    auto& mb = *current_builder;
+    return mb.ir_builder_.CreateMaskedGather(vector_gep(pointer_, indices_), type<element_type>::alignment,
+                                             mask_.eval(), pass_thru_.eval());
+  }
+
+  friend std::ostream& operator<<(std::ostream& os, gather_impl const& gi) {
+    return os << "gather(" << gi.pointer_ << ", " << gi.indices_ << ", " << gi.mask_ << ", " << gi.pass_thru_ << ")";
+  }
+};
+
+} // namespace detail
+
+template<size_t Size, typename Value> auto broadcast(Value v) {
+  return detail::broadcast_impl<Value, Size>(std::move(v));
+}
+
+template<typename Vector, typename Index> auto extract(Vector v, Index idx) {
+  return detail::extract_impl<Vector, Index>(std::move(v), std::move(idx));
+}
+
+template<typename Vector, typename Index, typename Element> auto insert(Vector v, Index idx, Element e) {
+  return detail::insert_impl<Vector, Index, Element>(std::move(v), std::move(idx), std::move(e));
+}
+
+template<unsigned... Indices, typename LHS, typename RHS> auto shuffle(LHS lhs, RHS rhs) {
+  return detail::shuffle_impl<LHS, RHS, Indices...>(std::move(lhs), std::move(rhs));
+}
+
+template<unsigned... Indices, typename Vector> auto shuffle(Vector v) {
+  using undef_type = detail::undef_vector<typename Vector::value_type>;
+  return detail::shuffle_impl<Vector, undef_type, Indices...>(std::move(v), undef_type{});
+}
+
+template<typename Vector> auto reduce_add(Vector v) {
+  return detail::reduction_operation<detail::reduction_operation_type::add, Vector>(std::move(v));
+}
+
+template<typename Vector> auto reduce_mul(Vector v) {
+  return detail::reduction_operation<detail::reduction_operation_type::mul, Vector>(std::move(v));
+}
+
+template<typename Vector,
+         typename = std::enable_if_t<std::is_integral_v<detail::element_type_t<typename Vector::value_type>>>>
+auto reduce_and(Vector v) {
+  return detail::reduction_operation<detail::reduction_operation_type::and_, Vector>(std::move(v));
+}
+
+template<typename Vector,
+         typename = std::enable_if_t<std::is_integral_v<detail::element_type_t<typename Vector::value_type>>>>
+auto reduce_or(Vector v) {
+  return detail::reduction_operation<detail::reduction_operation_type::or_, Vector>(std::move(v));
+}
+
+template<typename Vector,
+         typename = std::enable_if_t<std::is_integral_v<detail::element_type_t<typename Vector::value_type>>>>
+auto reduce_xor(Vector v) {
+  return detail::reduction_operation<detail::reduction_operation_type::xor_, Vector>(std::move(v));
+}
+
+template<typename Vector> auto reduce_min(Vector v) {
+  return detail::reduction_operation<detail::reduction_operation_type::min, Vector>(std::move(v));
+}
+
+template<typename Vector> auto reduce_max(Vector v) {
+  return detail::reduction_operation<detail::reduction_operation_type::max, Vector>(std::move(v));
+}
+
+template<typename Mask,
+         typename = std::enable_if_t<std::is_same_v<detail::element_type_t<typename Mask::value_type>, bool>>>
+auto any(Mask m) {
+  return reduce_or(std::move(m));
+}
+
+template<typename Mask,
+         typename = std::enable_if_t<std::is_same_v<detail::element_type_t<typename Mask::value_type>, bool>>>
+auto all(Mask m) {
+  return reduce_and(std::move(m));
+}
+
+template<typename Pointer, typename Mask, typename PassThru,
+         typename = std::enable_if_t<std::is_pointer_v<typename Pointer::value_type>>>
+auto masked_load(Pointer ptr, Mask m, PassThru pt) {
+  return detail::masked_load_impl<Pointer, Mask, PassThru>(std::move(ptr), std::move(m), std::move(pt));
+}
+
+template<typename Pointer, typename Indices, typename Mask, typename PassThru,
+         typename = std::enable_if_t<std::is_pointer_v<typename Pointer::value_type>>>
+auto gather(Pointer ptr, Indices idx, Mask m, PassThru pt) {
+  return detail::gather_impl<Pointer, Indices, Mask, PassThru>(std::move(ptr), std::move(idx), std::move(m),
+                                                                std::move(pt));
+}
+
+template<typename Value, typename Pointer, typename Mask> void masked_store(Value v, Pointer ptr, Mask m) {
+  using element_type = std::remove_pointer_t<typename Pointer::value_type>;
+  using vector_type = typename Value::value_type;
+  static_assert(!std::is_const_v<element_type>);
+  static_assert(std::is_same_v<vector_type, vec<element_type, detail::vector_size_v<vector_type>>>);
+  static_assert(std::is_same_v<typename Mask::value_type, detail::rebind_element_t<vector_type, bool>>);
+
+  auto& mb = *detail::current_builder;
+
+  auto line_no = mb.source_code_.add_line(fmt::format("masked_store({}, {}, {});", v, ptr, m));
+  mb.ir_builder_.SetCurrentDebugLocation(llvm::DebugLoc::get(line_no, 1, mb.dbg_scope_));
+  auto vec_ptr = mb.ir_builder_.CreateBitCast(ptr.eval(), detail::type<vector_type*>::llvm());
+  mb.ir_builder_.CreateMaskedStore(v.eval(), vec_ptr, detail::type<element_type>::alignment, m.eval());
+}
+
+template<typename Value, typename Pointer, typename Indices, typename Mask>
+void scatter(Value v, Pointer ptr, Indices idx, Mask m) {
+  using element_type = std::remove_pointer_t<typename Pointer::value_type>;
+  using vector_type = typename Value::value_type;
+  static_assert(!std::is_const_v<element_type>);
+  static_assert(std::is_same_v<vector_type, vec<element_type, detail::vector_size_v<vector_type>>>);
+  static_assert(detail::vector_size_v<typename Indices::value_type> == detail::vector_size_v<vector_type>);
+  static_assert(std::is_same_v<typename Mask::value_type, detail::rebind_element_t<vector_type, bool>>);
+
+  auto& mb = *detail::current_builder;
+
+  auto line_no = mb.source_code_.add_line(fmt::format("scatter({}, {}, {}, {});", v, ptr, idx, m));
+  mb.ir_builder_.SetCurrentDebugLocation(llvm::DebugLoc::get(line_no, 1, mb.dbg_scope_));
+  mb.ir_builder_.CreateMaskedScatter(v.eval(), detail::vector_gep(ptr, idx), detail::type<element_type>::alignment,
+                                     m.eval());
+}
+
+// Stores active lanes of v contiguously at ptr and returns their number. LLVM 8 is able to lower
+// llvm.masked.compressstore only on AVX-512 targets, hence the lanes are expanded explicitly.
+template<typename Value, typename Pointer, typename Mask>
+value<uint32_t> compress_store(Value v, Pointer ptr, Mask m) {
+  using element_type = std::remove_pointer_t<typename Pointer::value_type>;
+  using vector_type = typename Value::value_type;
+  constexpr auto size = detail::vector_size_v<vector_type>;
+  static_assert(!std::is_const_v<element_type>);
+  static_assert(std::is_same_v<vector_type, vec<element_type, size>>);
+  static_assert(std::is_same_v<typename Mask::value_type, mask<size>>);
+
+  auto& mb = *detail::current_builder;
+
+  auto line_no = mb.source_code_.add_line(fmt::format("compress_store_ret = compress_store({}, {}, {});", v, ptr, m));
+  mb.ir_builder_.SetCurrentDebugLocation(llvm::DebugLoc::get(line_no, 1, mb.dbg_scope_));
+
+  auto vector = v.eval();
+  auto pointer = ptr.eval();
+  auto lanes = m.eval();
+
+  llvm::Value* count = detail::get_constant<uint32_t>(0);
+  for (auto i = 0u; i < size; i++) {
+    auto active = mb.ir_builder_.CreateExtractElement(lanes, uint64_t(i));
+
+    auto store_block = llvm::BasicBlock::Create(*mb.context_, "compress_store_lane", mb.function_);
+    auto next_block = llvm::BasicBlock::Create(*mb.context_, "compress_store_next", mb.function_);
+    mb.ir_builder_.CreateCondBr(active, store_block, next_block);
+
+    mb.ir_builder_.SetInsertPoint(store_block);
+    mb.ir_builder_.CreateAlignedStore(mb.ir_builder_.CreateExtractElement(vector, uint64_t(i)),
+                                      mb.ir_builder_.CreateInBoundsGEP(pointer, count),
+                                      detail::type<element_type>::alignment);
+    mb.ir_builder_.CreateBr(next_block);
+
+    mb.ir_builder_.SetInsertPoint(next_block);
+    count = mb.ir_builder_.CreateAdd(count, mb.ir_builder_.CreateZExt(active, detail::type<uint32_t>::llvm()));
+  }
+  return value<uint32_t>{count, "compress_store_ret"};
+}
+
+} // namespace codegen
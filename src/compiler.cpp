@@ -29,22 +29,43 @@
 #include <llvm/Analysis/TargetLibraryInfo.h>
 #include <llvm/Analysis/TargetTransformInfo.h>
 
+#include <llvm/Bitcode/BitcodeReader.h>
+
 #include <llvm/ExecutionEngine/SectionMemoryManager.h>
 
 #include <llvm/ExecutionEngine/Orc/CompileUtils.h>
 #include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
 
 #include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <llvm/Linker/Linker.h>
 
+#include <llvm/Transforms/Coroutines.h>
 #include <llvm/Transforms/IPO.h>
+#include <llvm/Transforms/IPO/Internalize.h>
 #include <llvm/Transforms/IPO/PassManagerBuilder.h>
 
 #include "codegen/module.hpp"
 
 namespace codegen {
 
-compiler::compiler(llvm::orc::JITTargetMachineBuilder tmb)
-    : data_layout_(unwrap(tmb.getDefaultDataLayoutForTarget())), target_machine_(unwrap(tmb.createTargetMachine())),
+// The JIT linker can't resolve native TLS relocations, thread-local variables are lowered to calls to
+// __emutls_get_address() instead.
+compiler::configured_target compiler::configure_target(llvm::orc::JITTargetMachineBuilder tmb) {
+  llvm::InitializeNativeTarget();
+  llvm::InitializeNativeTargetAsmPrinter();
+
+  tmb.getOptions().EmulatedTLS = true;
+  tmb.getOptions().ExplicitEmulatedTLS = true;
+  return configured_target{std::move(tmb)};
+}
+
+compiler::compiler(llvm::orc::JITTargetMachineBuilder tmb) : compiler(configure_target(std::move(tmb))) {}
+
+compiler::compiler(configured_target target)
+    : data_layout_(unwrap(target.builder.getDefaultDataLayoutForTarget())),
+      target_machine_(unwrap(target.builder.createTargetMachine())),
       mangle_(session_, data_layout_), object_layer_(
                                            session_, [] { return std::make_unique<llvm::SectionMemoryManager>(); },
                                            [this](llvm::orc::VModuleKey vk, llvm::object::ObjectFile const& object,
@@ -52,7 +73,7 @@ compiler::compiler(llvm::orc::JITTargetMachineBuilder tmb)
                                              if (gdb_listener_) { gdb_listener_->notifyObjectLoaded(vk, object, info); }
                                              loaded_modules_.emplace_back(vk);
                                            }),
-      compile_layer_(session_, object_layer_, llvm::orc::ConcurrentIRCompiler(std::move(tmb))),
+      compile_layer_(session_, object_layer_, llvm::orc::ConcurrentIRCompiler(std::move(target.builder))),
       optimize_layer_(session_, compile_layer_,
                       [this](llvm::orc::ThreadSafeModule tsm, llvm::orc::MaterializationResponsibility const& mr) {
                         return optimize_module(std::move(tsm), mr);
@@ -91,9 +112,6 @@ compiler::compiler(llvm::orc::JITTargetMachineBuilder tmb)
 
 compiler::compiler()
     : compiler([] {
-        llvm::InitializeNativeTarget();
-        llvm::InitializeNativeTargetAsmPrinter();
-
         auto tmb = unwrap(llvm::orc::JITTargetMachineBuilder::detectHost());
         tmb.setCodeGenOptLevel(llvm::CodeGenOpt::Aggressive);
         tmb.setCPU(llvm::sys::getHostCPUName());
@@ -110,6 +128,8 @@ llvm::Expected<llvm::orc::ThreadSafeModule> compiler::optimize_module(llvm::orc:
                                                                       llvm::orc::MaterializationResponsibility const&) {
   auto module = tsm.getModule();
 
+  if (auto err = link_runtime_libraries(*module)) { return std::move(err); }
+
   auto target_triple = target_machine_->getTargetTriple();
 
   auto library_info = std::make_unique<llvm::TargetLibraryInfoImpl>(target_triple);
@@ -127,6 +147,7 @@ llvm::Expected<llvm::orc::ThreadSafeModule> compiler::optimize_module(llvm::orc:
   builder.DisableUnrollLoops = false;
   builder.RerollLoops = true;
   builder.LibraryInfo = new llvm::TargetLibraryInfoImpl(target_triple);
+  llvm::addCoroutinePassesToExtensionPoints(builder);
 
   function_passes.add(llvm::createTargetTransformInfoWrapperPass(target_machine_->getTargetIRAnalysis()));
   module_passes.add(llvm::createTargetTransformInfoWrapperPass(target_machine_->getTargetIRAnalysis()));
@@ -142,9 +163,54 @@ llvm::Expected<llvm::orc::ThreadSafeModule> compiler::optimize_module(llvm::orc:
 
   module_passes.run(*module);
 
+  if (optimized_ir_handler_) {
+    auto ir = std::string{};
+    auto ir_stream = llvm::raw_string_ostream(ir);
+    module->print(ir_stream, nullptr);
+    optimized_ir_handler_(ir_stream.str());
+  }
+
   return tsm;
 }
 
+void compiler::set_optimized_ir_handler(std::function<void(std::string const&)> handler) {
+  optimized_ir_handler_ = std::move(handler);
+}
+
+llvm::Error compiler::link_runtime_libraries(llvm::Module& module) {
+  for (auto& library : runtime_libraries_) {
+    // Function bodies are read lazily, only the ones the linker needs are materialised.
+    auto library_module = llvm::getLazyBitcodeModule(library->getMemBufferRef(), module.getContext());
+    if (!library_module) { return library_module.takeError(); }
+    (*library_module)->setDataLayout(module.getDataLayout());
+    (*library_module)->setTargetTriple(module.getTargetTriple());
+
+    // Only the functions used by the module are linked. They are made internal, so that they are removed once
+    // inlined, and optimised for the host CPU like the generated code.
+    auto failed = llvm::Linker::linkModules(
+        module, std::move(*library_module), llvm::Linker::Flags::LinkOnlyNeeded,
+        [this](llvm::Module& m, llvm::StringSet<> const& linked) {
+          for (auto& name : linked) {
+            if (auto fn = m.getFunction(name.getKey())) {
+              fn->addFnAttr("target-cpu", target_machine_->getTargetCPU());
+            }
+          }
+          llvm::internalizeModule(m, [&](llvm::GlobalValue const& gv) { return !linked.count(gv.getName()); });
+        });
+    if (failed) {
+      return llvm::make_error<llvm::StringError>("failed to link runtime library " + library->getBufferIdentifier(),
+                                                 llvm::inconvertibleErrorCode());
+    }
+  }
+  return llvm::Error::success();
+}
+
+void compiler::add_runtime_library(std::filesystem::path const& bitcode) {
+  auto library = unwrap(llvm::errorOrToExpected(llvm::MemoryBuffer::getFile(bitcode.string())));
+  unwrap(llvm::getBitcodeTargetTriple(library->getMemBufferRef()));
+  runtime_libraries_.emplace_back(std::move(library));
+}
+
 void compiler::add_symbol(std::string const& name, void* address) {
   external_symbols_[*mangle_(name)] = reinterpret_cast<uintptr_t>(address);
 }
@@ -22,8 +22,12 @@
 
 #include "codegen/module_builder.hpp"
 
+#include <algorithm>
 #include <fstream>
 
+#include <llvm/ADT/SmallPtrSet.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/MC/MCSubtargetInfo.h>
 #include <llvm/Support/raw_os_ostream.h>
 
 #include "codegen/compiler.hpp"
@@ -57,8 +61,59 @@ module module_builder::build() && {
   return module{compiler_->session_, compiler_->data_layout_};
 }
 
+module module_builder::build(std::initializer_list<llvm::Function*> entry_points) && {
+  // Functions which are only ever called directly can use the faster calling convention.
+  auto fast = llvm::SmallPtrSet<llvm::Function*, 16>{};
+  for (auto& fn : *module_) {
+    if (fn.isDeclaration() || std::find(entry_points.begin(), entry_points.end(), &fn) != entry_points.end()) {
+      continue;
+    }
+    fn.setLinkage(llvm::GlobalValue::InternalLinkage);
+    auto only_called = std::all_of(fn.user_begin(), fn.user_end(), [&](llvm::User* user) {
+      auto call = llvm::dyn_cast<llvm::CallInst>(user);
+      return call && call->getCalledFunction() == &fn;
+    });
+    if (only_called) { fast.insert(&fn); }
+  }
+
+  // musttail requires the caller and the callee to use the same calling convention, so functions linked by such calls
+  // either all switch to fastcc or all keep the convention they have.
+  auto calling_convention = [&](llvm::Function* fn) {
+    return fast.count(fn) ? llvm::CallingConv::Fast : fn->getCallingConv();
+  };
+  for (auto changed = true; changed;) {
+    changed = false;
+    for (auto& fn : *module_) {
+      for (auto& inst : llvm::instructions(fn)) {
+        auto call = llvm::dyn_cast<llvm::CallInst>(&inst);
+        if (!call || !call->isMustTailCall()) { continue; }
+        auto callee = call->getCalledFunction();
+        auto callee_convention = callee ? calling_convention(callee) : call->getCallingConv();
+        if (calling_convention(&fn) != callee_convention) {
+          changed |= fast.erase(&fn);
+          if (callee) { changed |= fast.erase(callee); }
+        }
+      }
+    }
+  }
+
+  for (auto fn : fast) {
+    fn->setCallingConv(llvm::CallingConv::Fast);
+    for (auto user : fn->users()) { llvm::cast<llvm::CallInst>(user)->setCallingConv(llvm::CallingConv::Fast); }
+  }
+  return std::move(*this).build();
+}
+
+bool module_builder::target_has_feature(std::string const& name) const {
+  // The subtarget includes the features implied by the target CPU, not only those listed explicitly. Unknown features
+  // are ignored by checkFeatures(), so they pass both checks.
+  auto subtarget = compiler_->target_machine_->getMCSubtargetInfo();
+  return subtarget->checkFeatures("+" + name) && !subtarget->checkFeatures("-" + name);
+}
+
 void module_builder::set_function_attributes(llvm::Function* fn) {
-  fn->addFnAttr("target-cpu", llvm::sys::getHostCPUName());
+  auto cpu = compiler_->target_machine_->getTargetCPU();
+  if (!cpu.empty()) { fn->addFnAttr("target-cpu", cpu); }
 }
 
 unsigned module_builder::source_code_generator::add_line(std::string const& line) {
@@ -74,6 +129,20 @@ void module_builder::declare_external_symbol(std::string const& name, void* addr
   compiler_->add_symbol(name, address);
 }
 
+llvm::GlobalVariable* module_builder::create_global_variable(std::string const& name, llvm::Constant* initializer,
+                                                             bool is_constant, llvm::DIType* dbg_type,
+                                                             std::string const& declaration,
+                                                             global_attributes const& attrs) {
+  auto gv = new llvm::GlobalVariable(*module_, initializer->getType(), is_constant,
+                                     llvm::GlobalValue::LinkageTypes::ExternalLinkage, initializer, name);
+  attrs.apply(gv);
+
+  auto line_no = source_code_.add_line((attrs.is_thread_local() ? "thread_local " : "") + declaration);
+  gv->addDebugInfo(
+      dbg_builder_.createGlobalVariableExpression(dbg_scope_, name, name, dbg_file_, line_no, dbg_type, false));
+  return gv;
+}
+
 std::ostream& operator<<(std::ostream& os, module_builder const& mb) {
   auto llvm_os = llvm::raw_os_ostream(os);
   mb.module_->print(llvm_os, nullptr);
@@ -92,7 +161,130 @@ void return_() {
   auto line_no = mb.source_code_.add_line("return;");
   mb.exited_block_ = true;
   mb.ir_builder_.SetCurrentDebugLocation(llvm::DebugLoc::get(line_no, 1, mb.dbg_scope_));
-  mb.ir_builder_.CreateRetVoid();
+  if (mb.current_coroutine_.final_suspend_block_) {
+    mb.ir_builder_.CreateBr(mb.current_coroutine_.final_suspend_block_);
+  } else {
+    mb.ir_builder_.CreateRetVoid();
+  }
 }
 
+namespace detail {
+
+void begin_coroutine(llvm::Value* frame, llvm::Value* frame_size, llvm::Type* promise_type) {
+  auto& mb = *current_builder;
+  auto& irb = mb.ir_builder_;
+  auto module = mb.module_.get();
+  auto null = llvm::ConstantPointerNull::get(irb.getInt8PtrTy());
+
+  // Marks the function as a coroutine which still needs to be split into the ramp and resume functions.
+  mb.function_->addFnAttr("coroutine.presplit", "0");
+
+  auto promise = irb.CreateAlloca(promise_type, nullptr, "promise");
+  auto id = irb.CreateCall(llvm::Intrinsic::getDeclaration(module, llvm::Intrinsic::coro_id),
+                           {irb.getInt32(0), irb.CreateBitCast(promise, irb.getInt8PtrTy()), null, null});
+
+  // The frame size is known only after the coroutine is split, the caller learns it from the first call to start().
+  auto size = irb.CreateCall(llvm::Intrinsic::getDeclaration(module, llvm::Intrinsic::coro_size, {irb.getInt64Ty()}));
+  auto capacity = irb.CreateAlignedLoad(frame_size, alignof(uint64_t));
+  irb.CreateAlignedStore(size, frame_size, alignof(uint64_t));
+
+  auto begin_block = llvm::BasicBlock::Create(*mb.context_, "coro_begin", mb.function_);
+  auto no_frame_block = llvm::BasicBlock::Create(*mb.context_, "coro_no_frame", mb.function_);
+  irb.CreateCondBr(irb.CreateAnd(irb.CreateICmpNE(frame, null), irb.CreateICmpUGE(capacity, size)), begin_block,
+                   no_frame_block);
+
+  irb.SetInsertPoint(no_frame_block);
+  irb.CreateRet(null);
+
+  irb.SetInsertPoint(begin_block);
+  auto handle = irb.CreateCall(llvm::Intrinsic::getDeclaration(module, llvm::Intrinsic::coro_begin), {id, frame});
+
+  auto& co = mb.current_coroutine_;
+  co.promise_ = promise;
+  co.final_suspend_block_ = llvm::BasicBlock::Create(*mb.context_, "coro_final_suspend");
+  co.cleanup_block_ = llvm::BasicBlock::Create(*mb.context_, "coro_cleanup");
+  co.suspend_block_ = llvm::BasicBlock::Create(*mb.context_, "coro_suspend");
+
+  auto suspend_builder = llvm::IRBuilder<>(co.suspend_block_);
+  suspend_builder.CreateCall(llvm::Intrinsic::getDeclaration(module, llvm::Intrinsic::coro_end),
+                             {handle, suspend_builder.getFalse()});
+  suspend_builder.CreateRet(handle);
+
+  // The memory belongs to the caller, so there is nothing to free.
+  llvm::BranchInst::Create(co.suspend_block_, co.cleanup_block_);
+
+  // The body is run only when the generator is resumed for the first time.
+  suspend_coroutine(false);
+}
+
+void suspend_coroutine(bool final) {
+  auto& mb = *current_builder;
+  auto& irb = mb.ir_builder_;
+  auto& co = mb.current_coroutine_;
+
+  auto suspend = irb.CreateCall(llvm::Intrinsic::getDeclaration(mb.module_.get(), llvm::Intrinsic::coro_suspend),
+                                {llvm::ConstantTokenNone::get(*mb.context_), irb.getInt1(final)});
+  auto resume_block = llvm::BasicBlock::Create(*mb.context_, final ? "coro_final_resume" : "coro_resume");
+  auto switch_inst = irb.CreateSwitch(suspend, co.suspend_block_, 2);
+  switch_inst->addCase(irb.getInt8(0), resume_block);
+  switch_inst->addCase(irb.getInt8(1), co.cleanup_block_);
+
+  mb.function_->getBasicBlockList().push_back(resume_block);
+  irb.SetInsertPoint(resume_block);
+  // Resuming a generator suspended at the final suspend point is not allowed.
+  if (final) { irb.CreateUnreachable(); }
+}
+
+void end_coroutine() {
+  auto& mb = *current_builder;
+  auto& co = mb.current_coroutine_;
+
+  if (!mb.exited_block_) { mb.ir_builder_.CreateBr(co.final_suspend_block_); }
+  mb.exited_block_ = true;
+
+  mb.function_->getBasicBlockList().push_back(co.final_suspend_block_);
+  mb.ir_builder_.SetInsertPoint(co.final_suspend_block_);
+  suspend_coroutine(true);
+
+  mb.function_->getBasicBlockList().push_back(co.cleanup_block_);
+  mb.function_->getBasicBlockList().push_back(co.suspend_block_);
+  co = {};
+}
+
+void resume_coroutine(llvm::Value* handle, llvm::Value* out, unsigned promise_alignment) {
+  auto& mb = *current_builder;
+  auto& irb = mb.ir_builder_;
+  auto module = mb.module_.get();
+
+  auto resume_block = llvm::BasicBlock::Create(*mb.context_, "resume", mb.function_);
+  auto yielded_block = llvm::BasicBlock::Create(*mb.context_, "yielded", mb.function_);
+  auto finished_block = llvm::BasicBlock::Create(*mb.context_, "finished", mb.function_);
+
+  auto line_no = mb.source_code_.add_line(fmt::format("if (done({})) {{ return false; }}", handle->getName().str()));
+  irb.SetCurrentDebugLocation(llvm::DebugLoc::get(line_no, 1, mb.dbg_scope_));
+  auto done = llvm::Intrinsic::getDeclaration(module, llvm::Intrinsic::coro_done);
+  irb.CreateCondBr(irb.CreateCall(done, {handle}), finished_block, resume_block);
+
+  irb.SetInsertPoint(resume_block);
+  line_no = mb.source_code_.add_line(fmt::format("resume({});", handle->getName().str()));
+  irb.SetCurrentDebugLocation(llvm::DebugLoc::get(line_no, 1, mb.dbg_scope_));
+  irb.CreateCall(llvm::Intrinsic::getDeclaration(module, llvm::Intrinsic::coro_resume), {handle});
+  irb.CreateCondBr(irb.CreateCall(done, {handle}), finished_block, yielded_block);
+
+  irb.SetInsertPoint(yielded_block);
+  line_no = mb.source_code_.add_line(fmt::format("*{} = promise({});", out->getName().str(), handle->getName().str()));
+  irb.SetCurrentDebugLocation(llvm::DebugLoc::get(line_no, 1, mb.dbg_scope_));
+  auto promise = irb.CreateCall(llvm::Intrinsic::getDeclaration(module, llvm::Intrinsic::coro_promise),
+                                {handle, irb.getInt32(promise_alignment), irb.getFalse()});
+  auto value = irb.CreateAlignedLoad(irb.CreateBitCast(promise, out->getType()), promise_alignment);
+  irb.CreateAlignedStore(value, out, promise_alignment);
+  irb.CreateRet(irb.getTrue());
+
+  irb.SetInsertPoint(finished_block);
+  irb.CreateRet(irb.getFalse());
+  mb.exited_block_ = true;
+}
+
+} // namespace detail
+
 } // namespace codegen
@@ -22,6 +22,8 @@
 
 #include "codegen/arithmetic_ops.hpp"
 
+#include <cmath>
+
 #include <gtest/gtest.h>
 
 #include "codegen/compiler.hpp"
@@ -103,6 +105,44 @@ TEST(arithmetic_ops, unsigned_integer_arithmetic) {
   EXPECT_EQ(mul_div_mod2_ptr(1, uint32_t(-7)), 1);
 }
 
+TEST(arithmetic_ops, int128_arithmetic) {
+  auto comp = codegen::compiler{};
+  auto builder = codegen::module_builder(comp, "int128_arithmetic");
+
+  auto sum = builder.create_function<__int128(int64_t, int64_t, int64_t)>(
+      "sum", [](codegen::value<int64_t> x, codegen::value<int64_t> y, codegen::value<int64_t> z) {
+        codegen::return_(codegen::cast<__int128>(x) + codegen::cast<__int128>(y) + codegen::cast<__int128>(z));
+      });
+
+  auto mul_div_mod2 = builder.create_function<__int128(__int128, __int128)>(
+      "mul_div_mod2",
+      [](codegen::value<__int128> x, codegen::value<__int128> y) { codegen::return_((x / y) * y + x % y); });
+
+  auto umul_add = builder.create_function<unsigned __int128(uint64_t, uint64_t)>(
+      "umul_add", [](codegen::value<uint64_t> x, codegen::value<uint64_t> y) {
+        auto big = static_cast<unsigned __int128>(1) << 100;
+        codegen::return_(codegen::cast<unsigned __int128>(x) * codegen::cast<unsigned __int128>(y) +
+                         codegen::constant<unsigned __int128>(big));
+      });
+
+  auto module = std::move(builder).build();
+
+  auto int64_max = std::numeric_limits<int64_t>::max();
+  auto sum_ptr = module.get_address(sum);
+  EXPECT_TRUE(sum_ptr(int64_max, int64_max, int64_max) == __int128(int64_max) * 3);
+  EXPECT_TRUE(sum_ptr(-int64_max, -int64_max, 1) == __int128(-int64_max) * 2 + 1);
+
+  auto mul_div_mod2_ptr = module.get_address(mul_div_mod2);
+  auto large = __int128(1) << 90;
+  EXPECT_TRUE(mul_div_mod2_ptr(large + 7, 1000) == large + 7);
+  EXPECT_TRUE(mul_div_mod2_ptr(-large, large / 3) == -large);
+
+  auto umul_add_ptr = module.get_address(umul_add);
+  auto uint64_max = std::numeric_limits<uint64_t>::max();
+  EXPECT_TRUE(umul_add_ptr(uint64_max, uint64_max) ==
+              static_cast<unsigned __int128>(uint64_max) * uint64_max + (static_cast<unsigned __int128>(1) << 100));
+}
+
 TEST(arithmetic_ops, float_arithmetic) {
   auto comp = codegen::compiler{};
   auto builder = codegen::module_builder(comp, "float_arithmetic");
@@ -142,6 +182,36 @@ TEST(arithmetic_ops, float_arithmetic) {
   EXPECT_EQ(mul_div_mod2_ptr(1, -7), 2);
 }
 
+TEST(arithmetic_ops, fast_math) {
+  auto comp = codegen::compiler{};
+  auto optimized_ir = std::string{};
+  comp.set_optimized_ir_handler([&](std::string const& ir) { optimized_ir = ir; });
+  auto builder = codegen::module_builder(comp, "fast_math");
+
+  auto add_zero = builder.create_function<float(float)>("add_zero", [](codegen::value<float> x) {
+    auto nsz = codegen::fast_math_flags{}.no_signed_zeros();
+    codegen::return_(codegen::fast_math(nsz, x + codegen::constant<float>(0.f)));
+  });
+  auto add_zero_strict = builder.create_function<float(float)>(
+      "add_zero_strict", [](codegen::value<float> x) { codegen::return_(x + codegen::constant<float>(0.f)); });
+  auto mul_add = builder.create_function<double(double, double, double)>(
+      "mul_add", [](codegen::value<double> x, codegen::value<double> y, codegen::value<double> z) {
+        codegen::return_(codegen::fast_math(codegen::fast_math_flags{}.contract(), x * y + z) - z);
+      });
+
+  auto module = std::move(builder).build();
+
+  EXPECT_TRUE(std::signbit(module.get_address(add_zero)(-0.f)));
+  EXPECT_EQ(module.get_address(add_zero)(2.5f), 2.5f);
+  EXPECT_FALSE(std::signbit(module.get_address(add_zero_strict)(-0.f)));
+
+  auto mul_add_ptr = module.get_address(mul_add);
+  EXPECT_DOUBLE_EQ(mul_add_ptr(2., 3., 4.), 6.);
+  EXPECT_NE(optimized_ir.find("fmul contract double"), std::string::npos);
+  EXPECT_NE(optimized_ir.find("fadd contract double"), std::string::npos);
+  EXPECT_NE(optimized_ir.find("fsub double"), std::string::npos);
+}
+
 TEST(arithmetic_ops, signed_integer_bitwise) {
   auto comp = codegen::compiler{};
   auto builder = codegen::module_builder(comp, "signed_integer_bitwise");
@@ -177,6 +247,49 @@ TEST(arithmetic_ops, signed_integer_bitwise) {
   EXPECT_EQ(and_or_xor4_ptr(3, 6, 11, 14), 13);
 }
 
+TEST(arithmetic_ops, shifts) {
+  auto comp = codegen::compiler{};
+  auto builder = codegen::module_builder(comp, "shifts");
+
+  auto shl = builder.create_function<int32_t(int32_t, int32_t)>(
+      "shl", [](codegen::value<int32_t> x, codegen::value<int32_t> y) { codegen::return_(x << y); });
+
+  auto ashr = builder.create_function<int32_t(int32_t, int32_t)>(
+      "ashr", [](codegen::value<int32_t> x, codegen::value<int32_t> y) { codegen::return_(x >> y); });
+
+  auto lshr = builder.create_function<uint32_t(uint32_t, uint32_t)>(
+      "lshr", [](codegen::value<uint32_t> x, codegen::value<uint32_t> y) { codegen::return_(x >> y); });
+
+  auto unpack = builder.create_function<uint64_t(uint64_t, uint64_t)>(
+      "unpack", [](codegen::value<uint64_t> x, codegen::value<uint64_t> idx) {
+        auto bits = codegen::constant<uint64_t>(5);
+        auto mask = (codegen::constant<uint64_t>(1) << bits) - codegen::constant<uint64_t>(1);
+        codegen::return_((x >> idx * bits) & mask);
+      });
+
+  auto module = std::move(builder).build();
+
+  auto shl_ptr = module.get_address(shl);
+  EXPECT_EQ(shl_ptr(1, 4), 16);
+  EXPECT_EQ(shl_ptr(-3, 2), -12);
+
+  auto ashr_ptr = module.get_address(ashr);
+  EXPECT_EQ(ashr_ptr(64, 3), 8);
+  EXPECT_EQ(ashr_ptr(-64, 3), -8);
+  EXPECT_EQ(ashr_ptr(-1, 31), -1);
+
+  auto lshr_ptr = module.get_address(lshr);
+  EXPECT_EQ(lshr_ptr(64, 3), 8);
+  EXPECT_EQ(lshr_ptr(0x80000000, 31), 1);
+
+  auto unpack_ptr = module.get_address(unpack);
+  auto packed = uint64_t(3) | (uint64_t(31) << 5) | (uint64_t(17) << 10);
+  EXPECT_EQ(unpack_ptr(packed, 0), 3);
+  EXPECT_EQ(unpack_ptr(packed, 1), 31);
+  EXPECT_EQ(unpack_ptr(packed, 2), 17);
+  EXPECT_EQ(unpack_ptr(packed, 3), 0);
+}
+
 TEST(arithmetic_ops, pointer_arithmetic) {
 
   auto comp = codegen::compiler{};
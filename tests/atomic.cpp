@@ -0,0 +1,189 @@
+/*
+ * Copyright © 2019 Paweł Dziepak
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "codegen/atomic.hpp"
+
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "codegen/arithmetic_ops.hpp"
+#include "codegen/compiler.hpp"
+#include "codegen/literals.hpp"
+#include "codegen/module.hpp"
+#include "codegen/module_builder.hpp"
+#include "codegen/relational_ops.hpp"
+#include "codegen/statements.hpp"
+#include "codegen/variable.hpp"
+
+namespace cg = codegen;
+using namespace cg::literals;
+
+TEST(atomic, load_store) {
+  auto comp = cg::compiler{};
+  auto builder = cg::module_builder(comp, "load_store");
+
+  auto publish = builder.create_function<void(int64_t*, int64_t*, int64_t)>(
+      "publish", [](cg::value<int64_t*> data, cg::value<int64_t*> flag, cg::value<int64_t> v) {
+        cg::atomic_store(v, data, std::memory_order_relaxed);
+        cg::fence(std::memory_order_release);
+        cg::atomic_store(1_i64, flag, std::memory_order_relaxed);
+        cg::return_();
+      });
+
+  auto consume = builder.create_function<int64_t(int64_t*, int64_t*)>(
+      "consume", [](cg::value<int64_t*> data, cg::value<int64_t*> flag) {
+        cg::while_([&] { return cg::atomic_load(flag, std::memory_order_acquire) == 0_i64; }, [] {});
+        cg::return_(cg::atomic_load(data, std::memory_order_relaxed));
+      });
+
+  auto module = std::move(builder).build();
+
+  auto publish_ptr = module.get_address(publish);
+  auto consume_ptr = module.get_address(consume);
+
+  int64_t data = 0;
+  int64_t flag = 0;
+  auto consumer = std::thread([&] { EXPECT_EQ(consume_ptr(&data, &flag), 42); });
+  publish_ptr(&data, &flag, 42);
+  consumer.join();
+}
+
+TEST(atomic, rmw) {
+  auto comp = cg::compiler{};
+  auto builder = cg::module_builder(comp, "rmw");
+
+  auto count = builder.create_function<void(uint64_t*, uint32_t const*, uint32_t)>(
+      "count", [](cg::value<uint64_t*> histogram, cg::value<uint32_t const*> values, cg::value<uint32_t> n) {
+        auto idx = cg::variable<uint32_t>("idx", 0_u32);
+        cg::while_([&] { return idx.get() < n; },
+                   [&] {
+                     auto v = cg::load(values + idx.get());
+                     cg::atomic_rmw(cg::atomic_rmw_operation::add, histogram + v, 1_u64, std::memory_order_relaxed);
+                     idx.set(idx.get() + 1_u32);
+                   });
+        cg::return_();
+      });
+
+  auto update_min = builder.create_function<int32_t(int32_t*, int32_t)>(
+      "update_min", [](cg::value<int32_t*> ptr, cg::value<int32_t> v) {
+        cg::return_(cg::atomic_rmw(cg::atomic_rmw_operation::min, ptr, v));
+      });
+
+  auto update_max = builder.create_function<uint32_t(uint32_t*, uint32_t)>(
+      "update_max", [](cg::value<uint32_t*> ptr, cg::value<uint32_t> v) {
+        cg::return_(cg::atomic_rmw(cg::atomic_rmw_operation::max, ptr, v));
+      });
+
+  auto exchange = builder.create_function<int32_t(int32_t*, int32_t)>(
+      "exchange", [](cg::value<int32_t*> ptr, cg::value<int32_t> v) {
+        cg::return_(cg::atomic_rmw(cg::atomic_rmw_operation::exchange, ptr, v, std::memory_order_acq_rel));
+      });
+
+  auto module = std::move(builder).build();
+
+  auto count_ptr = module.get_address(count);
+  auto values = std::vector<uint32_t>(100000);
+  for (auto i = 0u; i < values.size(); i++) { values[i] = i % 4; }
+  uint64_t histogram[4] = {};
+  auto threads = std::vector<std::thread>{};
+  for (auto i = 0; i < 4; i++) {
+    threads.emplace_back([&] { count_ptr(histogram, values.data(), values.size()); });
+  }
+  for (auto& t : threads) { t.join(); }
+  for (auto h : histogram) { EXPECT_EQ(h, values.size()); }
+
+  auto update_min_ptr = module.get_address(update_min);
+  int32_t min = 5;
+  EXPECT_EQ(update_min_ptr(&min, 7), 5);
+  EXPECT_EQ(min, 5);
+  EXPECT_EQ(update_min_ptr(&min, -3), 5);
+  EXPECT_EQ(min, -3);
+
+  auto update_max_ptr = module.get_address(update_max);
+  uint32_t max = 5;
+  EXPECT_EQ(update_max_ptr(&max, 0x80000000), 5);
+  EXPECT_EQ(max, 0x80000000);
+
+  auto exchange_ptr = module.get_address(exchange);
+  int32_t x = 1;
+  EXPECT_EQ(exchange_ptr(&x, 2), 1);
+  EXPECT_EQ(x, 2);
+}
+
+TEST(atomic, cmpxchg) {
+  auto comp = cg::compiler{};
+  auto builder = cg::module_builder(comp, "cmpxchg");
+
+  auto try_claim = builder.create_function<bool(uint64_t*, uint64_t, uint64_t*)>(
+      "try_claim", [](cg::value<uint64_t*> slot, cg::value<uint64_t> key, cg::value<uint64_t*> previous) {
+        auto [prev, success] = cg::cmpxchg(slot, 0_u64, key, std::memory_order_acq_rel, std::memory_order_acquire);
+        cg::store(prev, previous);
+        cg::return_(success);
+      });
+
+  auto module = std::move(builder).build();
+
+  auto try_claim_ptr = module.get_address(try_claim);
+  uint64_t slot = 0;
+  uint64_t previous;
+  EXPECT_TRUE(try_claim_ptr(&slot, 7, &previous));
+  EXPECT_EQ(previous, 0);
+  EXPECT_EQ(slot, 7);
+  EXPECT_FALSE(try_claim_ptr(&slot, 9, &previous));
+  EXPECT_EQ(previous, 7);
+  EXPECT_EQ(slot, 7);
+}
+
+TEST(atomic, invalid_orderings) {
+  auto comp = cg::compiler{};
+  auto builder = cg::module_builder(comp, "invalid_orderings");
+
+  auto fn = builder.create_function<uint64_t(uint64_t*)>("fn", [](cg::value<uint64_t*> ptr) {
+    EXPECT_THROW(cg::atomic_load(ptr, std::memory_order_release), std::invalid_argument);
+    EXPECT_THROW(cg::atomic_load(ptr, std::memory_order_acq_rel), std::invalid_argument);
+    EXPECT_THROW(cg::atomic_store(1_u64, ptr, std::memory_order_consume), std::invalid_argument);
+    EXPECT_THROW(cg::atomic_store(1_u64, ptr, std::memory_order_acquire), std::invalid_argument);
+    EXPECT_THROW(cg::atomic_store(1_u64, ptr, std::memory_order_acq_rel), std::invalid_argument);
+    EXPECT_THROW(cg::cmpxchg(ptr, 0_u64, 1_u64, std::memory_order_seq_cst, std::memory_order_release),
+                 std::invalid_argument);
+    EXPECT_THROW(cg::cmpxchg(ptr, 0_u64, 1_u64, std::memory_order_seq_cst, std::memory_order_acq_rel),
+                 std::invalid_argument);
+    EXPECT_THROW(cg::cmpxchg(ptr, 0_u64, 1_u64, std::memory_order_relaxed, std::memory_order_acquire),
+                 std::invalid_argument);
+    EXPECT_THROW(cg::cmpxchg(ptr, 0_u64, 1_u64, std::memory_order_acq_rel, std::memory_order_seq_cst),
+                 std::invalid_argument);
+    EXPECT_THROW(cg::fence(std::memory_order_relaxed), std::invalid_argument);
+
+    cg::atomic_store(2_u64, ptr, std::memory_order_release);
+    cg::fence(std::memory_order_acquire);
+    cg::return_(cg::atomic_load(ptr, std::memory_order_acquire));
+  });
+
+  auto module = std::move(builder).build();
+
+  uint64_t value = 0;
+  EXPECT_EQ(module.get_address(fn)(&value), 2);
+  EXPECT_EQ(value, 2);
+}
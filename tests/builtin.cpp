@@ -22,8 +22,18 @@
 
 #include "codegen/builtin.hpp"
 
+#include <cmath>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <tuple>
+#include <vector>
+
 #include <gtest/gtest.h>
 
+#include <llvm/Support/Host.h>
+
+#include "codegen/arithmetic_ops.hpp"
 #include "codegen/compiler.hpp"
 #include "codegen/module.hpp"
 #include "codegen/module_builder.hpp"
@@ -73,3 +83,305 @@ TEST(builtin, bswap) {
   auto bswap_i32_ptr = module.get_address(bswap_i32);
   EXPECT_EQ(bswap_i32_ptr(0x12345678), 0x78563412);
 }
+
+TEST(builtin, bit_operations) {
+  auto comp = codegen::compiler{};
+  auto builder = codegen::module_builder(comp, "bit_operations");
+
+  auto popcount = builder.create_function<uint32_t(uint32_t)>(
+      "popcount", [](codegen::value<uint32_t> v) { codegen::return_(codegen::builtin::popcount(v)); });
+  auto ctlz = builder.create_function<uint64_t(uint64_t)>(
+      "ctlz", [](codegen::value<uint64_t> v) { codegen::return_(codegen::builtin::ctlz(v)); });
+  auto cttz = builder.create_function<uint64_t(uint64_t)>(
+      "cttz", [](codegen::value<uint64_t> v) { codegen::return_(codegen::builtin::cttz(v)); });
+  auto bitreverse = builder.create_function<uint8_t(uint8_t)>(
+      "bitreverse", [](codegen::value<uint8_t> v) { codegen::return_(codegen::builtin::bitreverse(v)); });
+  auto rotl = builder.create_function<uint32_t(uint32_t, uint32_t)>(
+      "rotl", [](codegen::value<uint32_t> v, codegen::value<uint32_t> n) {
+        codegen::return_(codegen::builtin::rotl(v, n));
+      });
+  auto rotr = builder.create_function<uint64_t(uint64_t, uint64_t)>(
+      "rotr", [](codegen::value<uint64_t> v, codegen::value<uint64_t> n) {
+        codegen::return_(codegen::builtin::rotr(v, n));
+      });
+
+  auto ir = std::stringstream{};
+  ir << builder;
+  EXPECT_NE(ir.str().find("@llvm.ctpop.i32"), std::string::npos);
+  EXPECT_NE(ir.str().find("@llvm.ctlz.i64"), std::string::npos);
+  EXPECT_NE(ir.str().find("@llvm.cttz.i64"), std::string::npos);
+  EXPECT_NE(ir.str().find("@llvm.bitreverse.i8"), std::string::npos);
+  EXPECT_NE(ir.str().find("@llvm.fshl.i32"), std::string::npos);
+  EXPECT_NE(ir.str().find("@llvm.fshr.i64"), std::string::npos);
+
+  auto module = std::move(builder).build();
+
+  auto popcount_ptr = module.get_address(popcount);
+  EXPECT_EQ(popcount_ptr(0), 0);
+  EXPECT_EQ(popcount_ptr(0xf0f0f0f1), 17);
+
+  auto ctlz_ptr = module.get_address(ctlz);
+  EXPECT_EQ(ctlz_ptr(0), 64);
+  EXPECT_EQ(ctlz_ptr(1), 63);
+  EXPECT_EQ(ctlz_ptr(uint64_t(1) << 63), 0);
+
+  auto cttz_ptr = module.get_address(cttz);
+  EXPECT_EQ(cttz_ptr(0), 64);
+  EXPECT_EQ(cttz_ptr(1), 0);
+  EXPECT_EQ(cttz_ptr(0x100), 8);
+
+  auto bitreverse_ptr = module.get_address(bitreverse);
+  EXPECT_EQ(bitreverse_ptr(0x01), 0x80);
+  EXPECT_EQ(bitreverse_ptr(0x3a), 0x5c);
+
+  auto rotl_ptr = module.get_address(rotl);
+  EXPECT_EQ(rotl_ptr(0x80000001, 1), 0x00000003);
+  EXPECT_EQ(rotl_ptr(0x12345678, 36), 0x23456781);
+
+  auto rotr_ptr = module.get_address(rotr);
+  EXPECT_EQ(rotr_ptr(1, 1), uint64_t(1) << 63);
+  EXPECT_EQ(rotr_ptr(0x1234, 0), 0x1234);
+}
+
+TEST(builtin, bit_deposit) {
+  auto comp = codegen::compiler{};
+  auto builder = codegen::module_builder(comp, "bit_deposit");
+
+  auto pdep = builder.create_function<uint64_t(uint64_t, uint64_t)>(
+      "pdep", [](codegen::value<uint64_t> v, codegen::value<uint64_t> m) {
+        codegen::return_(codegen::builtin::pdep(v, m));
+      });
+  auto pext = builder.create_function<uint32_t(uint32_t, uint32_t)>(
+      "pext", [](codegen::value<uint32_t> v, codegen::value<uint32_t> m) {
+        codegen::return_(codegen::builtin::pext(v, m));
+      });
+
+  auto module = std::move(builder).build();
+
+  auto pdep_ptr = module.get_address(pdep);
+  EXPECT_EQ(pdep_ptr(0, 0xff), 0);
+  EXPECT_EQ(pdep_ptr(0b1011, 0xf0f0), 0xb0);
+  EXPECT_EQ(pdep_ptr(0b101, 0x8000000000000101), 0x8000000000000001);
+  EXPECT_EQ(pdep_ptr(~uint64_t(0), 0), 0);
+
+  auto pext_ptr = module.get_address(pext);
+  EXPECT_EQ(pext_ptr(0xb0, 0xf0f0), 0b1011);
+  EXPECT_EQ(pext_ptr(0x80000001, 0x80000101), 0b101);
+  EXPECT_EQ(pext_ptr(0xffffffff, 0), 0);
+}
+
+namespace {
+
+uint64_t reference_pdep(uint64_t value, uint64_t mask) {
+  auto result = uint64_t(0);
+  for (auto bit = uint64_t(1); mask; bit <<= 1) {
+    if (value & bit) { result |= mask & -mask; }
+    mask &= mask - 1;
+  }
+  return result;
+}
+
+uint64_t reference_pext(uint64_t value, uint64_t mask) {
+  auto result = uint64_t(0);
+  for (auto bit = uint64_t(1); mask; bit <<= 1) {
+    if (value & mask & -mask) { result |= bit; }
+    mask &= mask - 1;
+  }
+  return result;
+}
+
+} // namespace
+
+TEST(builtin, bit_deposit_fallback) {
+  // The host compiler uses the BMI2 instructions if the CPU supports them, the baseline x86-64 target has to use the
+  // generic loop. Both have to match the reference implementation.
+  auto host = codegen::compiler{};
+  auto tmb = llvm::orc::JITTargetMachineBuilder(llvm::Triple(llvm::sys::getProcessTriple()));
+#if defined(__x86_64__)
+  tmb.setCPU("x86-64");
+#endif
+  auto baseline = codegen::compiler(std::move(tmb));
+
+  using function = uint64_t (*)(uint64_t, uint64_t);
+  auto generate = [](codegen::compiler& comp, std::string const& name) {
+    auto builder = codegen::module_builder(comp, name);
+    auto pdep = builder.create_function<uint64_t(uint64_t, uint64_t)>(
+        "pdep", [](codegen::value<uint64_t> v, codegen::value<uint64_t> m) {
+          codegen::return_(codegen::builtin::pdep(v, m));
+        });
+    auto pext = builder.create_function<uint64_t(uint64_t, uint64_t)>(
+        "pext", [](codegen::value<uint64_t> v, codegen::value<uint64_t> m) {
+          codegen::return_(codegen::builtin::pext(v, m));
+        });
+    auto ir = std::stringstream{};
+    ir << builder;
+    auto uses_bmi2 = ir.str().find("@llvm.x86.bmi.") != std::string::npos;
+    EXPECT_EQ(uses_bmi2, builder.target_has_feature("bmi2"));
+    auto module = std::move(builder).build();
+    return std::tuple(uses_bmi2, function(module.get_address(pdep)), function(module.get_address(pext)));
+  };
+  auto [host_uses_bmi2, host_pdep, host_pext] = generate(host, "bit_deposit_host");
+  auto [baseline_uses_bmi2, baseline_pdep, baseline_pext] = generate(baseline, "bit_deposit_baseline");
+  (void)host_uses_bmi2;
+  EXPECT_FALSE(baseline_uses_bmi2);
+
+  auto values = std::vector<uint64_t>{0, 1, 0xf0f0, 0x8000000000000101, ~uint64_t(0)};
+  auto rng = std::mt19937_64{};
+  for (auto i = 0; i < 1000; i++) { values.emplace_back(rng()); }
+  for (auto v : values) {
+    for (auto m : {values[(v >> 3) % values.size()], uint64_t(0), ~uint64_t(0), uint64_t(0x00ff00ff00ff00ff)}) {
+      EXPECT_EQ(host_pdep(v, m), reference_pdep(v, m));
+      EXPECT_EQ(baseline_pdep(v, m), reference_pdep(v, m));
+      EXPECT_EQ(host_pext(v, m), reference_pext(v, m));
+      EXPECT_EQ(baseline_pext(v, m), reference_pext(v, m));
+    }
+  }
+}
+
+TEST(builtin, mulh) {
+  auto comp = codegen::compiler{};
+  auto builder = codegen::module_builder(comp, "mulh");
+
+  auto mulh_u64 = builder.create_function<uint64_t(uint64_t, uint64_t)>(
+      "mulh_u64", [](codegen::value<uint64_t> a, codegen::value<uint64_t> b) {
+        codegen::return_(codegen::builtin::mulh(a, b));
+      });
+  auto mulh_i64 = builder.create_function<int64_t(int64_t, int64_t)>(
+      "mulh_i64", [](codegen::value<int64_t> a, codegen::value<int64_t> b) {
+        codegen::return_(codegen::builtin::mulh(a, b));
+      });
+
+  auto module = std::move(builder).build();
+
+  auto mulh_u64_ptr = module.get_address(mulh_u64);
+  auto mulh_i64_ptr = module.get_address(mulh_i64);
+  auto u64_values = {uint64_t(0), uint64_t(1), uint64_t(0x123456789abcdef0), std::numeric_limits<uint64_t>::max()};
+  for (auto a : u64_values) {
+    for (auto b : u64_values) {
+      EXPECT_EQ(mulh_u64_ptr(a, b), uint64_t((static_cast<unsigned __int128>(a) * b) >> 64));
+    }
+  }
+  auto i64_values = {int64_t(0), int64_t(-1), int64_t(0x123456789abcdef0), std::numeric_limits<int64_t>::min(),
+                     std::numeric_limits<int64_t>::max()};
+  for (auto a : i64_values) {
+    for (auto b : i64_values) {
+      EXPECT_EQ(mulh_i64_ptr(a, b), int64_t((static_cast<__int128>(a) * b) >> 64));
+    }
+  }
+}
+
+TEST(builtin, min_max_abs) {
+  auto comp = codegen::compiler{};
+  auto builder = codegen::module_builder(comp, "min_max_abs");
+
+  auto min_i32 = builder.create_function<int32_t(int32_t, int32_t)>(
+      "min_i32",
+      [](codegen::value<int32_t> a, codegen::value<int32_t> b) { codegen::return_(codegen::builtin::min(a, b)); });
+  auto max_u32 = builder.create_function<uint32_t(uint32_t, uint32_t)>(
+      "max_u32",
+      [](codegen::value<uint32_t> a, codegen::value<uint32_t> b) { codegen::return_(codegen::builtin::max(a, b)); });
+  auto min_f64 = builder.create_function<double(double, double)>(
+      "min_f64",
+      [](codegen::value<double> a, codegen::value<double> b) { codegen::return_(codegen::builtin::min(a, b)); });
+  auto abs_i64 = builder.create_function<int64_t(int64_t)>(
+      "abs_i64", [](codegen::value<int64_t> a) { codegen::return_(codegen::builtin::abs(a)); });
+  auto abs_f32 = builder.create_function<float(float)>(
+      "abs_f32", [](codegen::value<float> a) { codegen::return_(codegen::builtin::abs(a)); });
+
+  auto module = std::move(builder).build();
+
+  auto min_i32_ptr = module.get_address(min_i32);
+  EXPECT_EQ(min_i32_ptr(-1, 1), -1);
+  EXPECT_EQ(min_i32_ptr(5, 3), 3);
+
+  auto max_u32_ptr = module.get_address(max_u32);
+  EXPECT_EQ(max_u32_ptr(uint32_t(-1), 1), uint32_t(-1));
+  EXPECT_EQ(max_u32_ptr(2, 3), 3);
+
+  auto min_f64_ptr = module.get_address(min_f64);
+  EXPECT_EQ(min_f64_ptr(1.5, -2.5), -2.5);
+  EXPECT_EQ(min_f64_ptr(std::numeric_limits<double>::quiet_NaN(), 4.), 4.);
+
+  auto abs_i64_ptr = module.get_address(abs_i64);
+  EXPECT_EQ(abs_i64_ptr(-7), 7);
+  EXPECT_EQ(abs_i64_ptr(7), 7);
+
+  auto abs_f32_ptr = module.get_address(abs_f32);
+  EXPECT_EQ(abs_f32_ptr(-0.5f), 0.5f);
+}
+
+TEST(builtin, floating_point) {
+  auto comp = codegen::compiler{};
+  auto builder = codegen::module_builder(comp, "floating_point");
+
+  auto fma = builder.create_function<double(double, double, double)>(
+      "fma", [](codegen::value<double> a, codegen::value<double> b, codegen::value<double> c) {
+        codegen::return_(codegen::builtin::fma(a, b, c));
+      });
+  auto sqrt = builder.create_function<double(double)>(
+      "sqrt", [](codegen::value<double> a) { codegen::return_(codegen::builtin::sqrt(a)); });
+  auto floor_ceil = builder.create_function<float(float)>("floor_ceil", [](codegen::value<float> a) {
+    codegen::return_(codegen::builtin::floor(a) + codegen::builtin::ceil(a));
+  });
+  auto copysign = builder.create_function<double(double, double)>(
+      "copysign", [](codegen::value<double> a, codegen::value<double> b) {
+        codegen::return_(codegen::builtin::copysign(a, b));
+      });
+
+  auto module = std::move(builder).build();
+
+  auto fma_ptr = module.get_address(fma);
+  EXPECT_EQ(fma_ptr(2., 3., 4.), 10.);
+  auto eps = std::numeric_limits<double>::epsilon();
+  EXPECT_EQ(fma_ptr(1. + eps, 1. - eps, -1.), std::fma(1. + eps, 1. - eps, -1.));
+
+  auto sqrt_ptr = module.get_address(sqrt);
+  EXPECT_EQ(sqrt_ptr(16.), 4.);
+
+  auto floor_ceil_ptr = module.get_address(floor_ceil);
+  EXPECT_EQ(floor_ceil_ptr(1.5f), 3.f);
+  EXPECT_EQ(floor_ceil_ptr(-1.5f), -3.f);
+  EXPECT_EQ(floor_ceil_ptr(2.f), 4.f);
+
+  auto copysign_ptr = module.get_address(copysign);
+  EXPECT_EQ(copysign_ptr(3., -0.), -3.);
+  EXPECT_EQ(copysign_ptr(-3., 1.), 3.);
+}
+
+TEST(builtin, prefetch_nontemporal) {
+  auto comp = codegen::compiler{};
+  auto builder = codegen::module_builder(comp, "prefetch_nontemporal");
+
+  auto sum_prefetched = builder.create_function<int64_t(int64_t const*, int64_t const*)>(
+      "sum_prefetched", [](codegen::value<int64_t const*> a, codegen::value<int64_t const*> b) {
+        codegen::builtin::prefetch(a);
+        codegen::builtin::prefetch<0>(b, codegen::builtin::prefetch_type::read);
+        codegen::return_(codegen::load(a) + codegen::load(b));
+      });
+
+  auto stream_copy = builder.create_function<void(int32_t const*, int32_t*)>(
+      "stream_copy", [](codegen::value<int32_t const*> src, codegen::value<int32_t*> dst) {
+        codegen::builtin::prefetch<1>(dst, codegen::builtin::prefetch_type::write);
+        auto v = codegen::builtin::nontemporal_load(src);
+        codegen::builtin::nontemporal_store(v, dst);
+        codegen::return_();
+      });
+
+  auto ir = std::stringstream{};
+  ir << builder;
+  EXPECT_NE(ir.str().find("@llvm.prefetch"), std::string::npos);
+  EXPECT_NE(ir.str().find("!nontemporal"), std::string::npos);
+
+  auto module = std::move(builder).build();
+
+  auto sum_prefetched_ptr = module.get_address(sum_prefetched);
+  int64_t a = 5;
+  int64_t b = 7;
+  EXPECT_EQ(sum_prefetched_ptr(&a, &b), 12);
+
+  auto stream_copy_ptr = module.get_address(stream_copy);
+  int32_t src = 0x12345678;
+  int32_t dst = 0;
+  stream_copy_ptr(&src, &dst);
+  EXPECT_EQ(dst, src);
+}
@@ -0,0 +1,166 @@
+/*
+ * Copyright © 2019 Paweł Dziepak
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "codegen/checked_ops.hpp"
+
+#include <limits>
+#include <sstream>
+
+#include <gtest/gtest.h>
+
+#include "codegen/arithmetic_ops.hpp"
+#include "codegen/compiler.hpp"
+#include "codegen/literals.hpp"
+#include "codegen/module.hpp"
+#include "codegen/module_builder.hpp"
+#include "codegen/relational_ops.hpp"
+#include "codegen/statements.hpp"
+#include "codegen/variable.hpp"
+
+namespace cg = codegen;
+using namespace cg::literals;
+
+TEST(checked_ops, overflow_flag) {
+  auto comp = cg::compiler{};
+  auto builder = cg::module_builder(comp, "overflow_flag");
+
+  auto add = builder.create_function<bool(int32_t, int32_t, int32_t*)>(
+      "add", [](cg::value<int32_t> a, cg::value<int32_t> b, cg::value<int32_t*> out) {
+        auto [result, overflow] = cg::checked_add(a, b);
+        cg::store(result, out);
+        cg::return_(overflow);
+      });
+
+  auto sub = builder.create_function<bool(uint32_t, uint32_t)>(
+      "sub", [](cg::value<uint32_t> a, cg::value<uint32_t> b) { cg::return_(cg::checked_sub(a, b).overflow); });
+
+  auto mul = builder.create_function<bool(int64_t, int64_t)>(
+      "mul", [](cg::value<int64_t> a, cg::value<int64_t> b) { cg::return_(cg::checked_mul(a, b).overflow); });
+
+  auto module = std::move(builder).build();
+
+  auto int32_max = std::numeric_limits<int32_t>::max();
+  auto int32_min = std::numeric_limits<int32_t>::min();
+
+  int32_t result;
+  auto add_ptr = module.get_address(add);
+  EXPECT_FALSE(add_ptr(1, 2, &result));
+  EXPECT_EQ(result, 3);
+  EXPECT_TRUE(add_ptr(int32_max, 1, &result));
+  EXPECT_EQ(result, int32_min);
+  EXPECT_TRUE(add_ptr(int32_min, -1, &result));
+
+  auto sub_ptr = module.get_address(sub);
+  EXPECT_FALSE(sub_ptr(2, 1));
+  EXPECT_TRUE(sub_ptr(1, 2));
+
+  auto mul_ptr = module.get_address(mul);
+  EXPECT_FALSE(mul_ptr(-3, 1ll << 60));
+  EXPECT_TRUE(mul_ptr(16, 1ll << 60));
+}
+
+TEST(checked_ops, overflow_handler) {
+  auto comp = cg::compiler{};
+  auto builder = cg::module_builder(comp, "overflow_handler");
+
+  auto sum = builder.create_function<int64_t(int64_t const*, uint32_t)>(
+      "sum", [](cg::value<int64_t const*> values, cg::value<uint32_t> n) {
+        auto acc = cg::variable<int64_t>("acc", 0_i64);
+        auto idx = cg::variable<uint32_t>("idx", 0_u32);
+        cg::while_([&] { return idx.get() < n; },
+                   [&] {
+                     acc.set(cg::checked_add(acc.get(), cg::load(values + idx.get()),
+                                             [] { cg::return_(cg::constant<int64_t>(-1)); }));
+                     idx.set(idx.get() + 1_u32);
+                   });
+        cg::return_(acc.get());
+      });
+
+  auto ir = std::stringstream{};
+  ir << builder;
+  EXPECT_NE(ir.str().find("@llvm.sadd.with.overflow.i64"), std::string::npos);
+  EXPECT_NE(ir.str().find("!prof"), std::string::npos);
+
+  auto module = std::move(builder).build();
+
+  auto sum_ptr = module.get_address(sum);
+  int64_t small[] = {1, 2, 3, -4};
+  EXPECT_EQ(sum_ptr(small, 4), 2);
+  int64_t large[] = {1, std::numeric_limits<int64_t>::max(), -5};
+  EXPECT_EQ(sum_ptr(large, 3), -1);
+}
+
+TEST(checked_ops, checked_cast) {
+  auto comp = cg::compiler{};
+  auto builder = cg::module_builder(comp, "checked_cast");
+
+  auto i32_to_i8 = builder.create_function<bool(int32_t)>(
+      "i32_to_i8", [](cg::value<int32_t> v) { cg::return_(cg::checked_cast<int8_t>(v).overflow); });
+  auto i16_to_u64 = builder.create_function<bool(int16_t)>(
+      "i16_to_u64", [](cg::value<int16_t> v) { cg::return_(cg::checked_cast<uint64_t>(v).overflow); });
+  auto u32_to_i32 = builder.create_function<bool(uint32_t)>(
+      "u32_to_i32", [](cg::value<uint32_t> v) { cg::return_(cg::checked_cast<int32_t>(v).overflow); });
+  auto u64_to_u16 = builder.create_function<uint16_t(uint64_t)>("u64_to_u16", [](cg::value<uint64_t> v) {
+    cg::return_(cg::checked_cast<uint16_t>(v, [] { cg::return_(0xffff_u16); }));
+  });
+
+  auto module = std::move(builder).build();
+
+  auto i32_to_i8_ptr = module.get_address(i32_to_i8);
+  EXPECT_FALSE(i32_to_i8_ptr(127));
+  EXPECT_FALSE(i32_to_i8_ptr(-128));
+  EXPECT_TRUE(i32_to_i8_ptr(128));
+  EXPECT_TRUE(i32_to_i8_ptr(-129));
+
+  auto i16_to_u64_ptr = module.get_address(i16_to_u64);
+  EXPECT_FALSE(i16_to_u64_ptr(5));
+  EXPECT_TRUE(i16_to_u64_ptr(-1));
+
+  auto u32_to_i32_ptr = module.get_address(u32_to_i32);
+  EXPECT_FALSE(u32_to_i32_ptr(0x7fffffff));
+  EXPECT_TRUE(u32_to_i32_ptr(0x80000000));
+
+  auto u64_to_u16_ptr = module.get_address(u64_to_u16);
+  EXPECT_EQ(u64_to_u16_ptr(1234), 1234);
+  EXPECT_EQ(u64_to_u16_ptr(0x10000), 0xffff);
+}
+
+TEST(checked_ops, saturating) {
+  auto comp = cg::compiler{};
+  auto builder = cg::module_builder(comp, "saturating");
+
+  auto add_i8 = builder.create_function<int8_t(int8_t, int8_t)>(
+      "add_i8", [](cg::value<int8_t> a, cg::value<int8_t> b) { cg::return_(cg::saturating_add(a, b)); });
+  auto sub_u32 = builder.create_function<uint32_t(uint32_t, uint32_t)>(
+      "sub_u32", [](cg::value<uint32_t> a, cg::value<uint32_t> b) { cg::return_(cg::saturating_sub(a, b)); });
+
+  auto module = std::move(builder).build();
+
+  auto add_i8_ptr = module.get_address(add_i8);
+  EXPECT_EQ(add_i8_ptr(100, 20), 120);
+  EXPECT_EQ(add_i8_ptr(100, 100), 127);
+  EXPECT_EQ(add_i8_ptr(-100, -100), -128);
+
+  auto sub_u32_ptr = module.get_address(sub_u32);
+  EXPECT_EQ(sub_u32_ptr(5, 3), 2);
+  EXPECT_EQ(sub_u32_ptr(3, 5), 0);
+}
@@ -0,0 +1,160 @@
+/*
+ * Copyright © 2019 Paweł Dziepak
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "codegen/decimal.hpp"
+
+#include <gtest/gtest.h>
+
+#include "codegen/arithmetic_ops.hpp"
+#include "codegen/compiler.hpp"
+#include "codegen/module.hpp"
+#include "codegen/module_builder.hpp"
+#include "codegen/relational_ops.hpp"
+#include "codegen/statements.hpp"
+#include "codegen/variable.hpp"
+
+TEST(decimal, arithmetic) {
+  auto comp = codegen::compiler{};
+  auto builder = codegen::module_builder(comp, "decimal_arithmetic");
+
+  auto add = builder.create_function<__int128(__int128, __int128)>(
+      "add", [](codegen::value<__int128> x, codegen::value<__int128> y) {
+        auto a = codegen::bit_cast<codegen::decimal<2>>(x);
+        auto b = codegen::bit_cast<codegen::decimal<2>>(y);
+        codegen::return_(codegen::bit_cast<__int128>(a + b - codegen::bit_cast<codegen::decimal<2>>(
+                                                                     codegen::constant<__int128>(100))));
+      });
+
+  auto mul = builder.create_function<__int128(__int128, __int128)>(
+      "mul", [](codegen::value<__int128> x, codegen::value<__int128> y) {
+        auto a = codegen::bit_cast<codegen::decimal<2>>(x);
+        auto b = codegen::bit_cast<codegen::decimal<3>>(y);
+        codegen::return_(codegen::bit_cast<__int128>(codegen::rescale<2>(a * b)));
+      });
+
+  auto div = builder.create_function<__int128(__int128, __int128)>(
+      "div", [](codegen::value<__int128> x, codegen::value<__int128> y) {
+        auto a = codegen::bit_cast<codegen::decimal<2>>(x);
+        auto b = codegen::bit_cast<codegen::decimal<1>>(y);
+        codegen::return_(codegen::bit_cast<__int128>(codegen::divide<4>(a, b)));
+      });
+
+  auto module = std::move(builder).build();
+
+  auto add_ptr = module.get_address(add);
+  EXPECT_TRUE(add_ptr(1050, 225) == 1175);
+  EXPECT_TRUE(add_ptr(-1050, 25) == -1125);
+
+  auto mul_ptr = module.get_address(mul);
+  // 12.34 * 2.500 = 30.85
+  EXPECT_TRUE(mul_ptr(1234, 2500) == 3085);
+  // -0.99 * 0.999 = -0.98901
+  EXPECT_TRUE(mul_ptr(-99, 999) == -98);
+
+  auto div_ptr = module.get_address(div);
+  // 10.00 / 3.0 = 3.3333
+  EXPECT_TRUE(div_ptr(1000, 30) == 33333);
+  // -1.00 / 8.0 = -0.125
+  EXPECT_TRUE(div_ptr(-100, 80) == -1250);
+  auto big = __int128(1) << 100;
+  EXPECT_TRUE(div_ptr(big, 10) == big * 100);
+}
+
+TEST(decimal, checked_mul) {
+  auto comp = codegen::compiler{};
+  auto builder = codegen::module_builder(comp, "decimal_checked_mul");
+
+  auto mul = builder.create_function<__int128(__int128, __int128)>(
+      "mul", [](codegen::value<__int128> x, codegen::value<__int128> y) {
+        auto a = codegen::bit_cast<codegen::decimal<10>>(x);
+        auto b = codegen::bit_cast<codegen::decimal<10>>(y);
+        auto product = codegen::checked_mul(a, b, [] { codegen::return_(codegen::constant<__int128>(-1)); });
+        codegen::return_(codegen::bit_cast<__int128>(codegen::rescale<10>(product)));
+      });
+  auto overflows = builder.create_function<bool(__int128, __int128)>(
+      "overflows", [](codegen::value<__int128> x, codegen::value<__int128> y) {
+        auto product = codegen::checked_mul(codegen::bit_cast<codegen::decimal<2>>(x),
+                                            codegen::bit_cast<codegen::decimal<3>>(y));
+        static_assert(std::is_same_v<decltype(product), codegen::checked_value<codegen::decimal<5>>>);
+        codegen::return_(product.overflow);
+      });
+
+  auto module = std::move(builder).build();
+
+  auto mul_ptr = module.get_address(mul);
+  auto one = __int128(10'000'000'000);
+  // 1.5 * 2.5 = 3.75
+  EXPECT_TRUE(mul_ptr(one * 3 / 2, one * 5 / 2) == one * 15 / 4);
+  // The unscaled product of 10^20 and 10^20 is 10^60, which doesn't fit in 128 bits.
+  auto big = one * 10'000'000'000 * 10'000'000'000;
+  EXPECT_TRUE(mul_ptr(big, big) == -1);
+  EXPECT_TRUE(mul_ptr(big, -big) == -1);
+
+  auto overflows_ptr = module.get_address(overflows);
+  auto max = static_cast<__int128>(~static_cast<unsigned __int128>(0) >> 1);
+  EXPECT_FALSE(overflows_ptr(1234, 2500));
+  EXPECT_FALSE(overflows_ptr(max, 1));
+  EXPECT_TRUE(overflows_ptr(max, 2));
+  EXPECT_TRUE(overflows_ptr(-max - 1, -1));
+}
+
+TEST(decimal, sum) {
+  auto comp = codegen::compiler{};
+  auto builder = codegen::module_builder(comp, "decimal_sum");
+
+  auto sum = builder.create_function<void(codegen::decimal<2>*, int64_t*, uint64_t)>(
+      "sum", [](codegen::value<codegen::decimal<2>*> out, codegen::value<int64_t*> values, codegen::value<uint64_t> n) {
+        auto acc = codegen::variable<codegen::decimal<2>>(
+            "acc", codegen::bit_cast<codegen::decimal<2>>(codegen::constant<__int128>(0)));
+        auto idx = codegen::variable<uint64_t>("idx", codegen::constant<uint64_t>(0));
+        codegen::while_([&] { return idx.get() < n; },
+                        [&] {
+                          auto v = codegen::bit_cast<codegen::decimal<0>>(
+                              codegen::cast<__int128>(codegen::load(values + idx.get())));
+                          acc.set(acc.get() + codegen::rescale<2>(v));
+                          idx.set(idx.get() + codegen::constant<uint64_t>(1));
+                        });
+        codegen::store(acc.get(), out);
+        codegen::return_();
+      });
+
+  auto compare = builder.create_function<bool(codegen::decimal<2>*, codegen::decimal<2>*)>(
+      "compare", [](codegen::value<codegen::decimal<2>*> x, codegen::value<codegen::decimal<2>*> y) {
+        codegen::return_(codegen::load(x) < codegen::load(y));
+      });
+
+  auto module = std::move(builder).build();
+
+  auto sum_ptr = module.get_address(sum);
+  auto int64_max = std::numeric_limits<int64_t>::max();
+  int64_t values[] = {int64_max, int64_max, int64_max, -1};
+  auto result = codegen::decimal<2>{};
+  sum_ptr(&result, values, 4);
+  EXPECT_TRUE(result.value == (__int128(int64_max) * 3 - 1) * 100);
+
+  auto compare_ptr = module.get_address(compare);
+  auto a = codegen::decimal<2>{-5};
+  auto b = codegen::decimal<2>{3};
+  EXPECT_TRUE(compare_ptr(&a, &b));
+  EXPECT_FALSE(compare_ptr(&b, &a));
+  EXPECT_FALSE(compare_ptr(&a, &a));
+}
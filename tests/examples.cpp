@@ -20,6 +20,7 @@
  * SOFTWARE.
  */
 
+#include <numeric>
 #include <random>
 
 #include <gtest/gtest.h>
@@ -170,6 +171,49 @@ TEST(examples, soa_compute) {
   test(dist(gen), std::move(b), std::move(c));
 }
 
+TEST(examples, soa_compute_noalias) {
+  auto build_compute = [](cg::compiler& comp, std::string const& name, auto... attrs) {
+    auto builder = codegen::module_builder(comp, "soa_compute_noalias");
+    auto compute = builder.create_function<void(int32_t, int32_t const*, int32_t const*, int32_t*, uint64_t)>(
+        name,
+        [&](cg::value<int32_t> a, cg::value<int32_t const*> b_ptr, cg::value<int32_t const*> c_ptr,
+            cg::value<int32_t*> d_ptr, cg::value<uint64_t> n) {
+          auto idx = cg::variable<uint64_t>("idx", 0_u64);
+          cg::while_([&] { return idx.get() < n; },
+                     [&] {
+                       auto i = idx.get();
+                       cg::store(a * cg::load(b_ptr + i) + cg::load(c_ptr + i), d_ptr + i);
+                       idx.set(i + 1_u64);
+                     });
+          cg::return_();
+        },
+        attrs...);
+    auto module = std::move(builder).build();
+    return module.get_address(compute);
+  };
+
+  auto ir = std::string{};
+  auto comp = codegen::compiler{};
+  comp.set_optimized_ir_handler([&](std::string const& optimized) { ir = optimized; });
+
+  build_compute(comp, "compute");
+  EXPECT_NE(ir.find("vector.memcheck"), std::string::npos);
+
+  auto compute_ptr = build_compute(comp, "compute_noalias", cg::function_attributes{}.nounwind(),
+                                   cg::parameter<1>().noalias().readonly(), cg::parameter<2>().noalias().readonly(),
+                                   cg::parameter<3>().noalias().writeonly());
+  EXPECT_EQ(ir.find("vector.memcheck"), std::string::npos);
+  EXPECT_NE(ir.find("noalias"), std::string::npos);
+
+  auto b = std::vector<int32_t>(1000);
+  auto c = std::vector<int32_t>(1000);
+  auto d = std::vector<int32_t>(1000);
+  std::iota(b.begin(), b.end(), -500);
+  std::iota(c.begin(), c.end(), 7);
+  compute_ptr(3, b.data(), c.data(), d.data(), d.size());
+  for (auto i = 0u; i < d.size(); i++) { EXPECT_EQ(d[i], 3 * b[i] + c[i]); }
+}
+
 TEST(examples, trivial_if) {
   auto comp = codegen::compiler{};
   auto builder = codegen::module_builder(comp, "trivial_if");
@@ -0,0 +1,176 @@
+/*
+ * Copyright © 2019 Paweł Dziepak
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "codegen/hash.hpp"
+
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <llvm/Support/Host.h>
+
+#include "codegen/compiler.hpp"
+#include "codegen/module.hpp"
+#include "codegen/module_builder.hpp"
+#include "codegen/statements.hpp"
+
+namespace {
+
+uint32_t reference_crc32c(uint32_t crc, uint64_t v, size_t size) {
+  for (auto i = 0u; i < size; i++) {
+    crc ^= (v >> (i * 8)) & 0xff;
+    for (auto j = 0; j < 8; j++) { crc = (crc >> 1) ^ (crc & 1 ? 0x82f63b78 : 0); }
+  }
+  return crc;
+}
+
+uint64_t reference_combine(uint64_t state, uint64_t v) {
+  auto product = static_cast<unsigned __int128>(state ^ 0xa0761d6478bd642full) * (v ^ 0xe7037ed1a0b428dbull);
+  return uint64_t(product) ^ uint64_t(product >> 64);
+}
+
+uint64_t reference_combine_bytes(uint64_t state, std::byte const* data, uint64_t n) {
+  auto offset = uint64_t(0);
+  for (; offset + 8 <= n; offset += 8) {
+    auto word = uint64_t{};
+    std::memcpy(&word, data + offset, sizeof(word));
+    state = reference_combine(state, word);
+  }
+  auto tail = uint64_t(0);
+  for (auto i = 0u; offset + i < n; i++) { tail |= uint64_t(data[offset + i]) << (i * 8); }
+  return reference_combine(reference_combine(state, tail), n);
+}
+
+} // namespace
+
+namespace {
+
+// Generates crc32c for all input sizes, checks the results against the reference implementation and returns whether
+// the SSE 4.2 instructions were used.
+bool check_crc32c(codegen::compiler& comp, std::string const& name) {
+  auto builder = codegen::module_builder(comp, name);
+
+  auto crc_u8 = builder.create_function<uint32_t(uint32_t, uint8_t)>(
+      "crc_u8", [](codegen::value<uint32_t> crc, codegen::value<uint8_t> v) {
+        codegen::return_(codegen::builtin::crc32c(crc, v));
+      });
+  auto crc_u16 = builder.create_function<uint32_t(uint32_t, uint16_t)>(
+      "crc_u16", [](codegen::value<uint32_t> crc, codegen::value<uint16_t> v) {
+        codegen::return_(codegen::builtin::crc32c(crc, v));
+      });
+  auto crc_u32 = builder.create_function<uint32_t(uint32_t, uint32_t)>(
+      "crc_u32", [](codegen::value<uint32_t> crc, codegen::value<uint32_t> v) {
+        codegen::return_(codegen::builtin::crc32c(crc, v));
+      });
+  auto crc_u64 = builder.create_function<uint32_t(uint32_t, uint64_t)>(
+      "crc_u64", [](codegen::value<uint32_t> crc, codegen::value<uint64_t> v) {
+        codegen::return_(codegen::builtin::crc32c(crc, v));
+      });
+
+  auto ir = std::stringstream{};
+  ir << builder;
+  auto uses_sse42 = ir.str().find("@llvm.x86.sse42.crc32") != std::string::npos;
+  EXPECT_EQ(uses_sse42, builder.target_has_feature("sse4.2"));
+
+  auto module = std::move(builder).build();
+
+  auto crc_u8_ptr = module.get_address(crc_u8);
+  auto crc = ~uint32_t(0);
+  for (auto c : std::string_view("123456789")) { crc = crc_u8_ptr(crc, c); }
+  EXPECT_EQ(~crc, 0xe3069283);
+
+  auto crc_u16_ptr = module.get_address(crc_u16);
+  auto crc_u32_ptr = module.get_address(crc_u32);
+  auto crc_u64_ptr = module.get_address(crc_u64);
+  for (auto v : {uint64_t(0), uint64_t(1), uint64_t(0x0123456789abcdef), ~uint64_t(0)}) {
+    for (auto seed : {uint32_t(0), uint32_t(0xdeadbeef), ~uint32_t(0)}) {
+      EXPECT_EQ(crc_u8_ptr(seed, v), reference_crc32c(seed, v, 1));
+      EXPECT_EQ(crc_u16_ptr(seed, v), reference_crc32c(seed, v, 2));
+      EXPECT_EQ(crc_u32_ptr(seed, v), reference_crc32c(seed, v, 4));
+      EXPECT_EQ(crc_u64_ptr(seed, v), reference_crc32c(seed, v, 8));
+    }
+  }
+  return uses_sse42;
+}
+
+} // namespace
+
+TEST(hash, crc32c) {
+  auto comp = codegen::compiler{};
+  check_crc32c(comp, "crc32c");
+}
+
+TEST(hash, crc32c_table) {
+  // The baseline x86-64 CPU doesn't support SSE 4.2, so the lookup table is used instead.
+  auto tmb = llvm::orc::JITTargetMachineBuilder(llvm::Triple(llvm::sys::getProcessTriple()));
+#if defined(__x86_64__)
+  tmb.setCPU("x86-64");
+#endif
+  auto comp = codegen::compiler(std::move(tmb));
+  EXPECT_FALSE(check_crc32c(comp, "crc32c_table"));
+}
+
+TEST(hash, hasher) {
+  auto comp = codegen::compiler{};
+  auto builder = codegen::module_builder(comp, "hasher");
+
+  auto hash = builder.create_function<uint64_t(int32_t, double, std::byte*, uint64_t)>(
+      "hash", [](codegen::value<int32_t> a, codegen::value<double> b, codegen::value<std::byte*> data,
+                 codegen::value<uint64_t> n) {
+        auto h = codegen::builtin::hasher(7);
+        h.add(a).add(b).add_bytes(data, n);
+        codegen::return_(h.get());
+      });
+
+  auto module = std::move(builder).build();
+  auto hash_ptr = module.get_address(hash);
+
+  auto reference = [](int32_t a, double b, std::byte const* data, uint64_t n) {
+    auto b_bits = uint64_t{};
+    std::memcpy(&b_bits, &b, sizeof(b));
+    auto state = reference_combine(reference_combine(7, uint32_t(a)), b_bits);
+    return reference_combine_bytes(state, data, n);
+  };
+
+  auto buffer = std::vector<std::byte>(64);
+  for (auto i = 0u; i < buffer.size(); i++) { buffer[i] = std::byte(i * 37 + 11); }
+
+  EXPECT_EQ(hash_ptr(1, 2.5, buffer.data(), 0), reference(1, 2.5, buffer.data(), 0));
+  EXPECT_NE(hash_ptr(1, 2.5, buffer.data(), 0), hash_ptr(2, 2.5, buffer.data(), 0));
+  EXPECT_NE(hash_ptr(1, 2.5, buffer.data(), 0), hash_ptr(1, -2.5, buffer.data(), 0));
+  EXPECT_EQ(hash_ptr(-1, 2.5, buffer.data(), 0), reference(-1, 2.5, buffer.data(), 0));
+
+  for (auto n = 0u; n <= 24; n++) {
+    EXPECT_EQ(hash_ptr(3, 0.5, buffer.data(), n), reference(3, 0.5, buffer.data(), n));
+    if (n) { EXPECT_NE(hash_ptr(3, 0.5, buffer.data(), n), hash_ptr(3, 0.5, buffer.data(), n - 1)); }
+
+    auto copy = std::vector<std::byte>(n + 8);
+    for (auto offset = 1u; offset < 8; offset++) {
+      std::memcpy(copy.data() + offset, buffer.data(), n);
+      EXPECT_EQ(hash_ptr(3, 0.5, copy.data() + offset, n), hash_ptr(3, 0.5, buffer.data(), n));
+    }
+  }
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright © 2019 Paweł Dziepak
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "codegen/interleave.hpp"
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "codegen/builtin.hpp"
+#include "codegen/compiler.hpp"
+#include "codegen/literals.hpp"
+#include "codegen/module.hpp"
+#include "codegen/module_builder.hpp"
+#include "codegen/relational_ops.hpp"
+#include "codegen/variable.hpp"
+
+namespace cg = codegen;
+using namespace cg::literals;
+
+TEST(interleave, chained_hash_table) {
+  // Nodes are triples of key, value and index of the next node. Index 0 terminates the chain.
+  constexpr auto bucket_count = 16;
+  auto buckets = std::vector<uint64_t>(bucket_count);
+  auto nodes = std::vector<uint64_t>{0, 0, 0};
+  for (auto key = uint64_t(1); key < 100; key += 3) {
+    auto& head = buckets[key % bucket_count];
+    auto idx = nodes.size() / 3;
+    nodes.insert(nodes.end(), {key, key * 10, head});
+    head = idx;
+  }
+  auto keys = std::vector<uint64_t>{};
+  for (auto key = uint64_t(0); key < 23; key++) { keys.emplace_back(key * 7 % 100); }
+
+  auto comp = cg::compiler{};
+  auto builder = cg::module_builder(comp, "chained_hash_table");
+
+  using probe_function = void(uint64_t const*, uint64_t const*, uint64_t const*, uint64_t, uint64_t*);
+  auto make_probe = [&](std::string const& name, size_t group_size) {
+    return builder.create_function<probe_function>(
+        name, [&](cg::value<uint64_t const*> bkts, cg::value<uint64_t const*> nds, cg::value<uint64_t const*> ks,
+                  cg::value<uint64_t> n, cg::value<uint64_t*> out) {
+          cg::interleaved_for_(
+              n, group_size,
+              [&](cg::value<uint64_t> i) {
+                auto bucket = cg::let(bkts + cg::load(ks + i) % cg::constant<uint64_t>(bucket_count));
+                cg::builtin::prefetch(bucket);
+                return bucket;
+              },
+              [&](cg::value<uint64_t>, cg::value<uint64_t const*> bucket) {
+                auto head = cg::let(cg::load(bucket));
+                cg::builtin::prefetch(nds + head * 3_u64);
+                return head;
+              },
+              [&](cg::value<uint64_t> i, cg::value<uint64_t> head) {
+                auto key = cg::let(cg::load(ks + i));
+                auto current = cg::variable<uint64_t>("current", head);
+                auto result = cg::variable<uint64_t>("result", 0_u64);
+                cg::while_([&] { return current.get() != 0_u64; },
+                           [&] {
+                             auto node = cg::let(nds + current.get() * 3_u64);
+                             cg::if_(cg::load(node) == key, [&] { result.set(cg::load(node + 1_u64)); });
+                             current.set(cg::load(node + 2_u64));
+                           });
+                cg::store(result.get(), out + i);
+              });
+          cg::return_();
+        });
+  };
+  auto naive = make_probe("naive", 1);
+  auto grouped = make_probe("grouped", 4);
+  auto uneven = make_probe("uneven", 5);
+
+  auto module = std::move(builder).build();
+
+  auto expected = std::vector<uint64_t>{};
+  for (auto key : keys) { expected.emplace_back(key % 3 == 1 ? key * 10 : 0); }
+
+  for (auto fn : {naive, grouped, uneven}) {
+    auto fn_ptr = module.get_address(fn);
+    for (auto n : {size_t(0), size_t(3), size_t(8), keys.size()}) {
+      auto out = std::vector<uint64_t>(n, ~uint64_t(0));
+      fn_ptr(buckets.data(), nodes.data(), keys.data(), n, out.data());
+      EXPECT_EQ(out, std::vector<uint64_t>(expected.begin(), expected.begin() + n));
+    }
+  }
+}
@@ -20,12 +20,22 @@
  * SOFTWARE.
  */
 
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <thread>
+#include <vector>
+
 #include <gtest/gtest.h>
 
+#include <llvm/Support/Host.h>
+
+#include "codegen/arithmetic_ops.hpp"
 #include "codegen/compiler.hpp"
 #include "codegen/literals.hpp"
 #include "codegen/module.hpp"
 #include "codegen/module_builder.hpp"
+#include "codegen/relational_ops.hpp"
 #include "codegen/statements.hpp"
 
 using namespace codegen::literals;
@@ -89,6 +99,339 @@ TEST(module_builder, external_functions) {
   EXPECT_TRUE(called);
 }
 
+TEST(module_builder, external_callables) {
+  auto comp = codegen::compiler{};
+  auto optimized_ir = std::string{};
+  comp.set_optimized_ir_handler([&](std::string const& ir) { optimized_ir = ir; });
+  auto builder = codegen::module_builder(comp, "external_callables");
+
+  auto output = std::vector<int32_t>{};
+  auto emit = [&](int32_t v) { output.push_back(v); };
+  auto next_id = 100;
+  auto allocate_id = [&]() -> int32_t { return next_id++; };
+
+  auto emit_fn = builder.declare_external_function<void(int32_t)>("emit", &emit);
+  auto allocate_id_fn = builder.declare_external_function<int32_t()>("allocate_id", &allocate_id);
+
+  auto produce = builder.create_function<void(int32_t)>("produce", [&](codegen::value<int32_t> v) {
+    codegen::call(emit_fn, v);
+    codegen::call(emit_fn, v + codegen::call(allocate_id_fn));
+    codegen::return_();
+  });
+
+  auto module = std::move(builder).build();
+
+  auto produce_ptr = module.get_address(produce);
+  produce_ptr(1);
+  produce_ptr(2);
+  EXPECT_EQ(output, (std::vector<int32_t>{1, 101, 2, 103}));
+  EXPECT_EQ(next_id, 102);
+
+  EXPECT_EQ(optimized_ir.find("@emit("), std::string::npos);
+  EXPECT_NE(optimized_ir.find("call void @emit_thunk("), std::string::npos);
+}
+
+TEST(module_builder, attributes) {
+  auto comp = codegen::compiler{};
+  auto optimized_ir = std::string{};
+  comp.set_optimized_ir_handler([&](std::string const& ir) { optimized_ir = ir; });
+  auto builder = codegen::module_builder(comp, "attributes");
+
+  auto square = builder.declare_external_function<int32_t(int32_t)>(
+      "square", [](int32_t v) { return v * v; }, codegen::function_attributes{}.readnone().nounwind());
+
+  auto twice = builder.create_function<int32_t(int32_t)>("twice", [&](codegen::value<int32_t> v) {
+    codegen::return_(codegen::call(square, v) + codegen::call(square, v));
+  });
+
+  auto copy = builder.create_function<void(int32_t*, int32_t const*)>(
+      "copy",
+      [&](codegen::value<int32_t*> dst, codegen::value<int32_t const*> src) {
+        codegen::store(codegen::load(src), dst);
+        codegen::return_();
+      },
+      codegen::parameter<0>().noalias().nonnull().writeonly().align(16).dereferenceable(64),
+      codegen::parameter<1>().readonly());
+
+  auto ir = std::stringstream{};
+  ir << builder;
+  for (auto attr : {"noalias", "nonnull", "writeonly", "align 16", "dereferenceable(64)", "readonly", "readnone",
+                    "nounwind"}) {
+    EXPECT_NE(ir.str().find(attr), std::string::npos) << attr;
+  }
+
+  auto module = std::move(builder).build();
+
+  auto twice_ptr = module.get_address(twice);
+  EXPECT_EQ(twice_ptr(3), 18);
+  auto first_call = optimized_ir.find("call i32 @square");
+  EXPECT_NE(first_call, std::string::npos);
+  EXPECT_EQ(optimized_ir.find("call i32 @square", first_call + 1), std::string::npos);
+
+  alignas(16) int32_t dst[16] = {};
+  int32_t src = 7;
+  module.get_address(copy)(dst, &src);
+  EXPECT_EQ(dst[0], 7);
+}
+
+TEST(module_builder, fast_math) {
+  auto comp = codegen::compiler{};
+  auto builder = codegen::module_builder(comp, "fast_math");
+
+  auto nsz = codegen::function_attributes{}.fast_math(codegen::fast_math_flags{}.no_signed_zeros());
+  auto add_zero = builder.create_function<float(float)>(
+      "add_zero", [](codegen::value<float> x) { codegen::return_(x + codegen::constant<float>(0.f)); }, nsz);
+  auto add_zero_strict = builder.create_function<float(float)>(
+      "add_zero_strict",
+      [](codegen::value<float> x) {
+        codegen::with_fast_math(codegen::fast_math_flags{},
+                                [&] { codegen::return_(x + codegen::constant<float>(0.f)); });
+      },
+      nsz);
+  auto add_zero_default = builder.create_function<float(float)>(
+      "add_zero_default", [](codegen::value<float> x) { codegen::return_(x + codegen::constant<float>(0.f)); });
+
+  auto ir = std::stringstream{};
+  ir << builder;
+  EXPECT_NE(ir.str().find("fadd nsz float"), std::string::npos);
+
+  auto module = std::move(builder).build();
+
+  EXPECT_TRUE(std::signbit(module.get_address(add_zero)(-0.f)));
+  EXPECT_FALSE(std::signbit(module.get_address(add_zero_strict)(-0.f)));
+  EXPECT_FALSE(std::signbit(module.get_address(add_zero_default)(-0.f)));
+  EXPECT_EQ(module.get_address(add_zero)(1.5f), 1.5f);
+}
+
+TEST(module_builder, target_features) {
+  auto comp = codegen::compiler{};
+  auto builder = codegen::module_builder(comp, "target_features");
+#if defined(__x86_64__)
+  EXPECT_TRUE(builder.target_has_feature("sse2"));
+#endif
+  EXPECT_FALSE(builder.target_has_feature("no-such-feature"));
+}
+
+#if defined(__x86_64__)
+TEST(module_builder, baseline_target_features) {
+  // Features implied by the CPU count, even though none are listed explicitly.
+  auto tmb = llvm::orc::JITTargetMachineBuilder(llvm::Triple(llvm::sys::getProcessTriple()));
+  tmb.setCPU("x86-64");
+  auto comp = codegen::compiler(std::move(tmb));
+  auto builder = codegen::module_builder(comp, "baseline_target_features");
+  EXPECT_TRUE(builder.target_has_feature("sse2"));
+  EXPECT_FALSE(builder.target_has_feature("sse4.2"));
+  EXPECT_FALSE(builder.target_has_feature("bmi2"));
+}
+#endif
+
+TEST(module_builder, custom_target) {
+  // Thread-local variables have to work regardless of how the compiler was constructed.
+  auto tmb = llvm::orc::JITTargetMachineBuilder(llvm::Triple(llvm::sys::getProcessTriple()));
+#if defined(__x86_64__)
+  tmb.setCPU("x86-64");
+#endif
+  auto comp = codegen::compiler(std::move(tmb));
+  auto builder = codegen::module_builder(comp, "custom_target");
+
+  auto counter = builder.create_global<uint64_t>("counter", 0, codegen::global_attributes{}.thread_local_());
+  auto count = builder.create_function<uint64_t()>("count", [&] {
+    auto v = codegen::load(counter) + 1_u64;
+    codegen::store(v, counter);
+    codegen::return_(v);
+  });
+
+  auto module = std::move(builder).build();
+  auto count_ptr = module.get_address(count);
+  EXPECT_EQ(count_ptr(), 1);
+  EXPECT_EQ(count_ptr(), 2);
+  auto other_thread = std::thread([&] { EXPECT_EQ(count_ptr(), 1); });
+  other_thread.join();
+  EXPECT_EQ(count_ptr(), 3);
+}
+
+TEST(module_builder, inlining_and_placement) {
+  auto comp = codegen::compiler{};
+  auto optimized_ir = std::string{};
+  comp.set_optimized_ir_handler([&](std::string const& ir) { optimized_ir = ir; });
+  auto builder = codegen::module_builder(comp, "inlining_and_placement");
+
+  auto min = builder.create_function<int32_t(int32_t, int32_t)>(
+      "min",
+      [](codegen::value<int32_t> a, codegen::value<int32_t> b) {
+        codegen::if_(a < b, [&] { codegen::return_(a); });
+        codegen::return_(b);
+      },
+      codegen::function_attributes{}.internal().alwaysinline());
+
+  auto error = builder.create_function<int32_t(int32_t)>(
+      "error", [](codegen::value<int32_t> v) { codegen::return_(v * codegen::constant<int32_t>(-1)); },
+      codegen::function_attributes{}.internal().noinline().cold().minsize());
+
+  auto hot = builder.create_function<int32_t(int32_t)>(
+      "hot", [](codegen::value<int32_t> v) { codegen::return_(v + 1_i32); }, codegen::function_attributes{}.hot());
+
+  auto clamp = builder.create_function<int32_t(int32_t, int32_t)>(
+      "clamp", [&](codegen::value<int32_t> v, codegen::value<int32_t> max) {
+        codegen::if_(max < 0_i32, [&] { codegen::return_(codegen::call(error, max)); });
+        codegen::return_(codegen::call(min, v, max));
+      });
+
+  auto ir = std::stringstream{};
+  ir << builder;
+  for (auto attr : {"internal fastcc", "call fastcc", "alwaysinline", "noinline", "cold", "minsize", "optsize",
+                    "!section_prefix"}) {
+    EXPECT_NE(ir.str().find(attr), std::string::npos) << attr;
+  }
+
+  auto module = std::move(builder).build();
+
+  auto clamp_ptr = module.get_address(clamp);
+  EXPECT_EQ(clamp_ptr(3, 5), 3);
+  EXPECT_EQ(clamp_ptr(7, 5), 5);
+  EXPECT_EQ(clamp_ptr(7, -5), 5);
+  EXPECT_EQ(module.get_address(hot)(1), 2);
+
+  EXPECT_EQ(optimized_ir.find("@min("), std::string::npos);
+  EXPECT_NE(optimized_ir.find("define internal fastcc i32 @error("), std::string::npos);
+}
+
+TEST(module_builder, entry_points) {
+  auto comp = codegen::compiler{};
+  auto optimized_ir = std::string{};
+  comp.set_optimized_ir_handler([&](std::string const& ir) { optimized_ir = ir; });
+  auto builder = codegen::module_builder(comp, "entry_points");
+
+  auto twice = builder.create_function<int32_t(int32_t)>(
+      "twice", [](codegen::value<int32_t> v) { codegen::return_(v + v); });
+  auto quadruple = builder.create_function<int32_t(int32_t)>(
+      "quadruple", [&](codegen::value<int32_t> v) { codegen::return_(codegen::call(twice, codegen::call(twice, v))); });
+
+  auto module = std::move(builder).build({quadruple});
+
+  auto quadruple_ptr = module.get_address(quadruple);
+  EXPECT_EQ(quadruple_ptr(3), 12);
+  EXPECT_EQ(optimized_ir.find("@twice("), std::string::npos);
+  EXPECT_ANY_THROW(module.get_address(twice));
+}
+
+TEST(module_builder, globals) {
+  auto comp = codegen::compiler{};
+  auto optimized_ir = std::string{};
+  comp.set_optimized_ir_handler([&](std::string const& ir) { optimized_ir = ir; });
+  auto builder = codegen::module_builder(comp, "globals");
+
+  int32_t dictionary[] = {10, 20, 30, 40};
+  auto decode_table = builder.create_constant_array("decode_table", dictionary, std::size(dictionary));
+  auto calls = builder.create_global<uint64_t>("calls", 5);
+  auto histogram = builder.create_global_array<uint32_t>("histogram", 4, codegen::global_attributes{}.align(64));
+  auto thread_calls = builder.create_global<uint64_t>("thread_calls", 0, codegen::global_attributes{}.thread_local_());
+
+  auto decode = builder.create_function<int32_t(uint32_t)>("decode", [&](codegen::value<uint32_t> idx) {
+    auto bucket = histogram + idx;
+    codegen::store(codegen::load(bucket) + 1_u32, bucket);
+    codegen::store(codegen::load(calls) + 1_u64, calls);
+    codegen::return_(codegen::load(decode_table + idx));
+  });
+  auto decode_third = builder.create_function<int32_t()>(
+      "decode_third", [&] { codegen::return_(codegen::load(decode_table + 2_u32)); });
+  auto count_thread_calls = builder.create_function<uint64_t()>("count_thread_calls", [&] {
+    auto v = codegen::load(thread_calls) + 1_u64;
+    codegen::store(v, thread_calls);
+    codegen::return_(v);
+  });
+
+  auto module = std::move(builder).build();
+
+  auto decode_ptr = module.get_address(decode);
+  EXPECT_EQ(decode_ptr(0), 10);
+  EXPECT_EQ(decode_ptr(3), 40);
+  EXPECT_EQ(decode_ptr(3), 40);
+  EXPECT_EQ(module.get_address(decode_third)(), 30);
+
+  auto decode_third_ir = optimized_ir.substr(optimized_ir.find("@decode_third("));
+  decode_third_ir = decode_third_ir.substr(0, decode_third_ir.find("\n}\n"));
+  EXPECT_EQ(decode_third_ir.find(" load "), std::string::npos);
+  EXPECT_NE(decode_third_ir.find("ret i32 30"), std::string::npos);
+
+  auto calls_ptr = module.get_address(calls);
+  EXPECT_EQ(*calls_ptr, 8);
+  *calls_ptr = 0;
+  decode_ptr(1);
+  EXPECT_EQ(*calls_ptr, 1);
+
+  auto histogram_ptr = module.get_address(histogram);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(histogram_ptr) % 64, 0);
+  EXPECT_EQ(histogram_ptr[0], 1);
+  EXPECT_EQ(histogram_ptr[1], 1);
+  EXPECT_EQ(histogram_ptr[2], 0);
+  EXPECT_EQ(histogram_ptr[3], 2);
+
+  auto decode_table_ptr = module.get_address(decode_table);
+  EXPECT_TRUE(std::equal(std::begin(dictionary), std::end(dictionary), decode_table_ptr));
+
+  auto count_thread_calls_ptr = module.get_address(count_thread_calls);
+  EXPECT_EQ(count_thread_calls_ptr(), 1);
+  EXPECT_EQ(count_thread_calls_ptr(), 2);
+  auto other_thread = std::thread([&] {
+    EXPECT_EQ(count_thread_calls_ptr(), 1);
+    EXPECT_EQ(count_thread_calls_ptr(), 2);
+    EXPECT_EQ(count_thread_calls_ptr(), 3);
+  });
+  other_thread.join();
+  EXPECT_EQ(count_thread_calls_ptr(), 3);
+}
+
+namespace {
+
+int32_t add_one(int32_t v) {
+  return v + 1;
+}
+
+} // namespace
+
+TEST(module_builder, pointer_constants) {
+  auto comp = codegen::compiler{};
+  auto optimized_ir = std::string{};
+  comp.set_optimized_ir_handler([&](std::string const& ir) { optimized_ir = ir; });
+  auto builder = codegen::module_builder(comp, "pointer_constants");
+
+  int32_t host_value = 7;
+  int32_t host_table[] = {3, 5, 8};
+
+  auto read_host_value = builder.create_function<int32_t()>(
+      "read_host_value", [&] { codegen::return_(codegen::load(codegen::constant(&host_value))); });
+  auto call_host_function = builder.create_function<int32_t(int32_t)>(
+      "call_host_function",
+      [&](codegen::value<int32_t> v) { codegen::return_(codegen::call(codegen::constant(&add_one), v)); });
+  auto read_frozen = builder.create_function<int32_t()>("read_frozen", [&] {
+    auto table = codegen::freeze(host_table, std::size(host_table));
+    codegen::return_(codegen::load(table + 1_u32) + codegen::load(table + 2_u32));
+  });
+  auto read_frozen_pointer = builder.create_function<int32_t()>("read_frozen_pointer", [&] {
+    int32_t* pointers[] = {&host_table[2]};
+    codegen::return_(codegen::load(codegen::load(codegen::freeze(pointers, 1))));
+  });
+
+  auto module = std::move(builder).build();
+
+  auto read_host_value_ptr = module.get_address(read_host_value);
+  EXPECT_EQ(read_host_value_ptr(), 7);
+  host_value = 9;
+  EXPECT_EQ(read_host_value_ptr(), 9);
+
+  EXPECT_EQ(module.get_address(call_host_function)(4), 5);
+
+  auto read_frozen_ptr = module.get_address(read_frozen);
+  auto read_frozen_ir = optimized_ir.substr(optimized_ir.find("@read_frozen("));
+  read_frozen_ir = read_frozen_ir.substr(0, read_frozen_ir.find("\n}\n"));
+  EXPECT_EQ(read_frozen_ir.find(" load "), std::string::npos);
+
+  host_table[1] = 0;
+  EXPECT_EQ(read_frozen_ptr(), 13);
+  EXPECT_EQ(module.get_address(read_frozen_pointer)(), 8);
+}
+
 TEST(module_builder, bit_cast) {
   auto comp = codegen::compiler{};
   auto builder = codegen::module_builder(comp, "bit_cast");
@@ -132,3 +475,27 @@ TEST(module_builder, cast) {
   auto u16_to_u64_ptr = module.get_address(u16_to_u64);
   EXPECT_EQ(u16_to_u64_ptr(-1), 0xffff);
 }
+
+TEST(module_builder, select) {
+  auto comp = codegen::compiler{};
+  auto builder = codegen::module_builder(comp, "select");
+
+  auto clamp_negative = builder.create_function<int32_t(int32_t)>("clamp_negative", [&](codegen::value<int32_t> x) {
+    codegen::return_(codegen::select(x < 0_i32, 0_i32, x));
+  });
+
+  auto pick = builder.create_function<double(bool, double, double)>(
+      "pick", [&](codegen::value<bool> cnd, codegen::value<double> a, codegen::value<double> b) {
+        codegen::return_(codegen::select(cnd, a, b));
+      });
+
+  auto module = std::move(builder).build();
+
+  auto clamp_negative_ptr = module.get_address(clamp_negative);
+  EXPECT_EQ(clamp_negative_ptr(-5), 0);
+  EXPECT_EQ(clamp_negative_ptr(7), 7);
+
+  auto pick_ptr = module.get_address(pick);
+  EXPECT_EQ(pick_ptr(true, 1.5, 2.5), 1.5);
+  EXPECT_EQ(pick_ptr(false, 1.5, 2.5), 2.5);
+}
@@ -24,6 +24,7 @@
 
 #include <gtest/gtest.h>
 
+#include "codegen/arithmetic_ops.hpp"
 #include "codegen/compiler.hpp"
 #include "codegen/module.hpp"
 #include "codegen/module_builder.hpp"
@@ -223,3 +224,49 @@ TEST(relational_ops, floating_point) {
   EXPECT_EQ(lt2_ptr(-1, -3), false);
   EXPECT_EQ(lt2_ptr(-5, -4), true);
 }
+
+TEST(relational_ops, logical) {
+  auto comp = codegen::compiler{};
+  auto builder = codegen::module_builder(comp, "logical");
+
+  auto safe_div_gt = builder.create_function<bool(int32_t, int32_t, int32_t)>(
+      "safe_div_gt", [](codegen::value<int32_t> x, codegen::value<int32_t> y, codegen::value<int32_t> z) {
+        codegen::return_(x != codegen::constant<int32_t>(0) && y / x > z);
+      });
+
+  auto zero_or_div_gt = builder.create_function<bool(int32_t, int32_t, int32_t)>(
+      "zero_or_div_gt", [](codegen::value<int32_t> x, codegen::value<int32_t> y, codegen::value<int32_t> z) {
+        codegen::return_(x == codegen::constant<int32_t>(0) || y / x > z);
+      });
+
+  auto in_range = builder.create_function<bool(int32_t, int32_t, int32_t)>(
+      "in_range", [](codegen::value<int32_t> x, codegen::value<int32_t> lo, codegen::value<int32_t> hi) {
+        codegen::return_((x >= lo) & (x < hi));
+      });
+
+  auto outside_range = builder.create_function<bool(int32_t, int32_t, int32_t)>(
+      "outside_range", [](codegen::value<int32_t> x, codegen::value<int32_t> lo, codegen::value<int32_t> hi) {
+        codegen::return_(!((x >= lo) & (x < hi)) | codegen::false_());
+      });
+
+  auto module = std::move(builder).build();
+
+  auto safe_div_gt_ptr = module.get_address(safe_div_gt);
+  EXPECT_EQ(safe_div_gt_ptr(0, 10, 1), false);
+  EXPECT_EQ(safe_div_gt_ptr(2, 10, 1), true);
+  EXPECT_EQ(safe_div_gt_ptr(2, 10, 5), false);
+
+  auto zero_or_div_gt_ptr = module.get_address(zero_or_div_gt);
+  EXPECT_EQ(zero_or_div_gt_ptr(0, 10, 1), true);
+  EXPECT_EQ(zero_or_div_gt_ptr(2, 10, 1), true);
+  EXPECT_EQ(zero_or_div_gt_ptr(2, 10, 5), false);
+
+  auto in_range_ptr = module.get_address(in_range);
+  EXPECT_EQ(in_range_ptr(1, 1, 3), true);
+  EXPECT_EQ(in_range_ptr(3, 1, 3), false);
+  EXPECT_EQ(in_range_ptr(0, 1, 3), false);
+
+  auto outside_range_ptr = module.get_address(outside_range);
+  EXPECT_EQ(outside_range_ptr(1, 1, 3), false);
+  EXPECT_EQ(outside_range_ptr(3, 1, 3), true);
+}
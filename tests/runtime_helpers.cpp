@@ -0,0 +1,44 @@
+/*
+ * Copyright © 2019 Paweł Dziepak
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Helper functions compiled to LLVM bitcode at build time and linked into the modules generated by the
+// runtime_library test.
+
+#include <cstdint>
+#include <limits>
+
+namespace {
+
+constexpr uint32_t weights[] = {1, 10, 100, 1000};
+
+} // namespace
+
+extern "C" int32_t saturating_add(int32_t a, int32_t b) {
+  auto result = int64_t(a) + b;
+  if (result > std::numeric_limits<int32_t>::max()) { return std::numeric_limits<int32_t>::max(); }
+  if (result < std::numeric_limits<int32_t>::min()) { return std::numeric_limits<int32_t>::min(); }
+  return result;
+}
+
+extern "C" uint32_t weight(uint32_t v) {
+  return weights[v % 4];
+}
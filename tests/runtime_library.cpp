@@ -0,0 +1,70 @@
+/*
+ * Copyright © 2019 Paweł Dziepak
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <limits>
+
+#include <gtest/gtest.h>
+
+#include "codegen/arithmetic_ops.hpp"
+#include "codegen/compiler.hpp"
+#include "codegen/module.hpp"
+#include "codegen/module_builder.hpp"
+#include "codegen/statements.hpp"
+
+TEST(runtime_library, inline_helpers) {
+  auto comp = codegen::compiler{};
+  auto optimized_ir = std::string{};
+  comp.set_optimized_ir_handler([&](std::string const& ir) { optimized_ir = ir; });
+  comp.add_runtime_library(CODEGEN_RUNTIME_HELPERS);
+  auto builder = codegen::module_builder(comp, "inline_helpers");
+
+  auto saturating_add = builder.declare_runtime_function<int32_t(int32_t, int32_t)>("saturating_add");
+  auto weight = builder.declare_runtime_function<uint32_t(uint32_t)>("weight");
+
+  auto add = builder.create_function<int32_t(int32_t, int32_t)>(
+      "add", [&](codegen::value<int32_t> a, codegen::value<int32_t> b) {
+        codegen::return_(codegen::call(saturating_add, a, b));
+      });
+  auto weighted = builder.create_function<uint32_t(uint32_t, uint32_t)>(
+      "weighted", [&](codegen::value<uint32_t> a, codegen::value<uint32_t> b) {
+        codegen::return_(codegen::call(weight, a) + codegen::call(weight, b));
+      });
+
+  auto module = std::move(builder).build();
+
+  auto add_ptr = module.get_address(add);
+  EXPECT_EQ(add_ptr(2, 3), 5);
+  EXPECT_EQ(add_ptr(std::numeric_limits<int32_t>::max() - 1, 5), std::numeric_limits<int32_t>::max());
+  EXPECT_EQ(add_ptr(std::numeric_limits<int32_t>::min() + 1, -5), std::numeric_limits<int32_t>::min());
+
+  auto weighted_ptr = module.get_address(weighted);
+  EXPECT_EQ(weighted_ptr(1, 6), 110);
+
+  EXPECT_EQ(optimized_ir.find("@saturating_add("), std::string::npos);
+  EXPECT_EQ(optimized_ir.find("@weight("), std::string::npos);
+  EXPECT_ANY_THROW(module.get_address(saturating_add));
+}
+
+TEST(runtime_library, missing_file) {
+  auto comp = codegen::compiler{};
+  EXPECT_ANY_THROW(comp.add_runtime_library("/nonexistent/runtime.bc"));
+}
@@ -22,6 +22,12 @@
 
 #include "codegen/statements.hpp"
 
+#include <numeric>
+#include <regex>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
 #include <gtest/gtest.h>
 
 #include "codegen/arithmetic_ops.hpp"
@@ -154,6 +160,524 @@ TEST(statements, store) {
   EXPECT_EQ(value, -4);
 }
 
+namespace {
+
+size_t count_instructions(std::string const& ir, std::string const& function, std::string const& opcode) {
+  auto begin = ir.find("@" + function + "(");
+  auto end = ir.find("\n}\n", begin);
+  auto instruction = " " + opcode + " ";
+  auto count = size_t(0);
+  for (auto pos = ir.find(instruction, begin); pos < end; pos = ir.find(instruction, pos + 1)) { count++; }
+  return count;
+}
+
+} // namespace
+
+TEST(statements, type_based_alias_analysis) {
+  auto comp = codegen::compiler{};
+  auto optimized_ir = std::string{};
+  comp.set_optimized_ir_handler([&](std::string const& ir) { optimized_ir = ir; });
+  auto builder = codegen::module_builder(comp, "type_based_alias_analysis");
+
+  auto reload = [&](auto name, auto store_type) {
+    using store_type_t = decltype(store_type);
+    return builder.create_function<float(float*, store_type_t*, store_type_t)>(
+        name, [](codegen::value<float*> a, codegen::value<store_type_t*> b, codegen::value<store_type_t> v) {
+          auto x = codegen::load(a);
+          codegen::store(v, b);
+          codegen::return_(x + codegen::load(a));
+        });
+  };
+  auto reload_i32 = reload("reload_i32", int32_t{});
+  reload("reload_byte", std::byte{});
+  auto reload_f32 = reload("reload_f32", float{});
+
+  auto ir = std::stringstream{};
+  ir << builder;
+  EXPECT_NE(ir.str().find("!tbaa"), std::string::npos);
+
+  auto module = std::move(builder).build();
+  auto reload_i32_ptr = module.get_address(reload_i32);
+  auto reload_f32_ptr = module.get_address(reload_f32);
+
+  EXPECT_EQ(count_instructions(optimized_ir, "reload_i32", "load"), 1);
+  EXPECT_EQ(count_instructions(optimized_ir, "reload_byte", "load"), 2);
+  EXPECT_EQ(count_instructions(optimized_ir, "reload_f32", "load"), 2);
+
+  float f = 1.5f;
+  int32_t i = 0;
+  EXPECT_EQ(reload_i32_ptr(&f, &i, 4), 3.0f);
+  EXPECT_EQ(i, 4);
+  EXPECT_EQ(reload_f32_ptr(&f, &f, 2.0f), 3.5f);
+}
+
+TEST(statements, alias_scopes) {
+  auto comp = codegen::compiler{};
+  auto optimized_ir = std::string{};
+  comp.set_optimized_ir_handler([&](std::string const& ir) { optimized_ir = ir; });
+  auto builder = codegen::module_builder(comp, "alias_scopes");
+
+  auto reload = builder.create_function<int32_t(int32_t*, int32_t*)>(
+      "reload", [](codegen::value<int32_t*> a, codegen::value<int32_t*> b) {
+        auto [a_scope, b_scope] = codegen::make_alias_scopes<2>("buffers");
+        auto x = codegen::load(a, a_scope);
+        codegen::store(codegen::constant<int32_t>(7), b, b_scope);
+        codegen::return_(x + codegen::load(a, a_scope));
+      });
+
+  auto module = std::move(builder).build();
+  auto reload_ptr = module.get_address(reload);
+
+  EXPECT_EQ(count_instructions(optimized_ir, "reload", "load"), 1);
+
+  int32_t a = 3;
+  int32_t b = 0;
+  EXPECT_EQ(reload_ptr(&a, &b), 6);
+  EXPECT_EQ(b, 7);
+}
+
+TEST(statements, let) {
+  auto comp = codegen::compiler{};
+  auto builder = codegen::module_builder(comp, "let");
+
+  auto without_let = builder.create_function<int32_t(int32_t, int32_t)>(
+      "without_let", [](codegen::value<int32_t> a, codegen::value<int32_t> b) {
+        auto x = a * b;
+        auto y = x * x;
+        codegen::return_(y * y);
+      });
+  auto with_let = builder.create_function<int32_t(int32_t, int32_t)>(
+      "with_let", [](codegen::value<int32_t> a, codegen::value<int32_t> b) {
+        auto x = codegen::let(a * b);
+        auto y = codegen::let(x * x);
+        codegen::return_(y * y);
+      });
+  auto count_down = builder.create_function<int32_t(int32_t)>("count_down", [](codegen::value<int32_t> n) {
+    auto i = codegen::variable<int32_t>("i", n);
+    codegen::while_([&] { return i.get() > codegen::constant<int32_t>(0); },
+                    [&] { i.set(i.get() - codegen::constant<int32_t>(1)); });
+    codegen::return_(i.get());
+  });
+
+  auto ir = std::stringstream{};
+  ir << builder;
+  EXPECT_EQ(count_instructions(ir.str(), "without_let", "mul"), 7);
+  EXPECT_EQ(count_instructions(ir.str(), "with_let", "mul"), 3);
+  EXPECT_EQ(count_instructions(ir.str(), "count_down", "icmp"), 1);
+
+  auto module = std::move(builder).build();
+  auto without_let_ptr = module.get_address(without_let);
+  auto with_let_ptr = module.get_address(with_let);
+  EXPECT_EQ(without_let_ptr(2, 3), 1296);
+  EXPECT_EQ(with_let_ptr(2, 3), 1296);
+  EXPECT_EQ(module.get_address(count_down)(5), 0);
+}
+
+TEST(statements, for_loop) {
+  auto comp = codegen::compiler{};
+  auto builder = codegen::module_builder(comp, "for_loop");
+
+  auto sum = builder.create_function<int32_t(int32_t, int32_t, int32_t)>(
+      "sum", [](codegen::value<int32_t> begin, codegen::value<int32_t> end, codegen::value<int32_t> step) {
+        auto acc = codegen::variable<int32_t>("acc", codegen::constant<int32_t>(0));
+        codegen::for_(begin, end, step, [&](codegen::value<int32_t> i) { acc.set(acc.get() + i); });
+        codegen::return_(acc.get());
+      });
+
+  auto find = builder.create_function<uint64_t(uint32_t const*, uint64_t, uint32_t)>(
+      "find", [](codegen::value<uint32_t const*> values, codegen::value<uint64_t> n, codegen::value<uint32_t> v) {
+        codegen::for_(codegen::constant<uint64_t>(0), n, codegen::constant<uint64_t>(1),
+                      [&](codegen::value<uint64_t> i) {
+                        codegen::if_(codegen::load(values + i) == v, [&] { codegen::return_(i); });
+                      });
+        codegen::return_(n);
+      });
+
+  auto count_odd = builder.create_function<uint32_t(uint32_t)>("count_odd", [](codegen::value<uint32_t> n) {
+    auto count = codegen::variable<uint32_t>("count", codegen::constant<uint32_t>(0));
+    codegen::for_(codegen::constant<uint32_t>(0), codegen::constant<uint32_t>(100), codegen::constant<uint32_t>(1),
+                  [&](codegen::value<uint32_t> i) {
+                    codegen::if_(i == n, [] { codegen::break_(); });
+                    codegen::if_((i & codegen::constant<uint32_t>(1)) == codegen::constant<uint32_t>(0),
+                                 [] { codegen::continue_(); });
+                    count.set(count.get() + codegen::constant<uint32_t>(1));
+                  });
+    codegen::return_(count.get());
+  });
+
+  auto module = std::move(builder).build();
+
+  auto sum_ptr = module.get_address(sum);
+  EXPECT_EQ(sum_ptr(0, 5, 1), 10);
+  EXPECT_EQ(sum_ptr(-4, 5, 3), -4 + -1 + 2);
+  EXPECT_EQ(sum_ptr(5, 5, 1), 0);
+  EXPECT_EQ(sum_ptr(6, 5, 1), 0);
+
+  auto find_ptr = module.get_address(find);
+  uint32_t values[] = {4, 8, 15, 16, 23, 42};
+  EXPECT_EQ(find_ptr(values, 6, 15), 2);
+  EXPECT_EQ(find_ptr(values, 6, 7), 6);
+
+  auto count_odd_ptr = module.get_address(count_odd);
+  EXPECT_EQ(count_odd_ptr(10), 5);
+  EXPECT_EQ(count_odd_ptr(1000), 50);
+}
+
+TEST(statements, for_loop_hints) {
+  auto comp = codegen::compiler{};
+  auto optimized_ir = std::string{};
+  comp.set_optimized_ir_handler([&](std::string const& ir) { optimized_ir = ir; });
+  auto builder = codegen::module_builder(comp, "for_loop_hints");
+
+  auto add = builder.create_function<void(int32_t*, int32_t const*, uint64_t)>(
+      "add", [](codegen::value<int32_t*> dst, codegen::value<int32_t const*> src, codegen::value<uint64_t> n) {
+        codegen::for_(
+            codegen::constant<uint64_t>(0), n, codegen::constant<uint64_t>(1),
+            [&](codegen::value<uint64_t> i) {
+              codegen::store(codegen::load(dst + i) + codegen::load(src + i), dst + i);
+            },
+            codegen::loop_hints{}.vectorize_width(8).interleave_count(1).parallel_accesses());
+        codegen::return_();
+      });
+
+  auto ir = std::stringstream{};
+  ir << builder;
+  for (auto hint : {"llvm.loop.vectorize.width", "llvm.loop.interleave.count", "llvm.loop.parallel_accesses",
+                    "!llvm.access.group"}) {
+    EXPECT_NE(ir.str().find(hint), std::string::npos) << hint;
+  }
+
+  auto module = std::move(builder).build();
+  auto add_ptr = module.get_address(add);
+
+  EXPECT_NE(optimized_ir.find("<8 x i32>"), std::string::npos);
+  EXPECT_EQ(optimized_ir.find("vector.memcheck"), std::string::npos);
+
+  auto dst = std::vector<int32_t>(100);
+  auto src = std::vector<int32_t>(100);
+  std::iota(dst.begin(), dst.end(), 0);
+  std::iota(src.begin(), src.end(), 100);
+  add_ptr(dst.data(), src.data(), dst.size());
+  for (auto i = 0u; i < dst.size(); i++) { EXPECT_EQ(dst[i], int32_t(2 * i + 100)); }
+}
+
+TEST(statements, nested_parallel_loops) {
+  auto comp = codegen::compiler{};
+  auto builder = codegen::module_builder(comp, "nested_parallel_loops");
+
+  auto scale = builder.create_function<void(int32_t*, uint64_t, uint64_t)>(
+      "scale", [](codegen::value<int32_t*> data, codegen::value<uint64_t> rows, codegen::value<uint64_t> columns) {
+        codegen::for_(
+            codegen::constant<uint64_t>(0), rows, codegen::constant<uint64_t>(1),
+            [&](codegen::value<uint64_t> row) {
+              codegen::for_(
+                  codegen::constant<uint64_t>(0), columns, codegen::constant<uint64_t>(1),
+                  [&](codegen::value<uint64_t> column) {
+                    auto ptr = codegen::let(data + row * columns + column);
+                    codegen::store(codegen::load(ptr) * codegen::constant<int32_t>(3), ptr);
+                  },
+                  codegen::loop_hints{}.parallel_accesses());
+            },
+            codegen::loop_hints{}.parallel_accesses());
+        codegen::return_();
+      });
+
+  auto ir = std::stringstream{};
+  ir << builder;
+  auto ir_str = ir.str();
+
+  // The store in the inner loop belongs to the access groups of both loops.
+  auto match = std::smatch{};
+  ASSERT_TRUE(std::regex_search(ir_str, match, std::regex("store .*!llvm.access.group (![0-9]+)")));
+  auto groups = match[1].str();
+  EXPECT_TRUE(std::regex_search(ir_str, std::regex(groups + " = !\\{![0-9]+, ![0-9]+\\}")));
+
+  auto module = std::move(builder).build();
+  auto scale_ptr = module.get_address(scale);
+
+  auto data = std::vector<int32_t>(6 * 7);
+  std::iota(data.begin(), data.end(), 0);
+  scale_ptr(data.data(), 6, 7);
+  for (auto i = 0u; i < data.size(); i++) { EXPECT_EQ(data[i], int32_t(3 * i)); }
+}
+
+TEST(statements, fast_math_scope) {
+  auto comp = codegen::compiler{};
+  auto optimized_ir = std::string{};
+  comp.set_optimized_ir_handler([&](std::string const& ir) { optimized_ir = ir; });
+  auto builder = codegen::module_builder(comp, "fast_math_scope");
+
+  auto sum = builder.create_function<float(float const*, uint64_t)>(
+      "sum", [](codegen::value<float const*> data, codegen::value<uint64_t> n) {
+        auto acc = codegen::variable<float>("acc", codegen::constant<float>(0.f));
+        codegen::with_fast_math(codegen::fast_math_flags{}.reassoc(), [&] {
+          codegen::for_(codegen::constant<uint64_t>(0), n, codegen::constant<uint64_t>(1),
+                        [&](codegen::value<uint64_t> i) { acc.set(acc.get() + codegen::load(data + i)); });
+        });
+        codegen::return_(acc.get());
+      });
+
+  auto module = std::move(builder).build();
+
+  auto values = std::vector<float>(1000);
+  std::iota(values.begin(), values.end(), 0.f);
+  EXPECT_EQ(module.get_address(sum)(values.data(), values.size()), 999.f * 1000.f / 2.f);
+  EXPECT_NE(optimized_ir.find("fadd reassoc <"), std::string::npos);
+}
+
+TEST(statements, switch_statement) {
+  auto comp = codegen::compiler{};
+  auto builder = codegen::module_builder(comp, "switch_statement");
+
+  // A tiny stack-less interpreter: 0 - add, 1 - multiply, 2 - negate, 3 - stop, anything else - error.
+  auto interpret = builder.create_function<int32_t(uint8_t const*, int32_t const*, int32_t)>(
+      "interpret", [](codegen::value<uint8_t const*> opcodes, codegen::value<int32_t const*> operands,
+                      codegen::value<int32_t> init) {
+        auto acc = codegen::variable<int32_t>("acc", init);
+        codegen::for_(codegen::constant<uint64_t>(0), codegen::constant<uint64_t>(16), codegen::constant<uint64_t>(1),
+                      [&](codegen::value<uint64_t> i) {
+                        codegen::switch_(
+                            codegen::load(opcodes + i),
+                            codegen::case_(0, [&] { acc.set(acc.get() + codegen::load(operands + i)); }),
+                            codegen::case_(1, [&] { acc.set(acc.get() * codegen::load(operands + i)); }),
+                            codegen::case_(2, [&] { acc.set(codegen::constant<int32_t>(0) - acc.get()); }),
+                            codegen::case_(3, [&] { codegen::break_(); }),
+                            codegen::default_([&] { codegen::return_(codegen::constant<int32_t>(-1)); }));
+                      });
+        codegen::return_(acc.get());
+      });
+
+  auto ir = std::stringstream{};
+  ir << builder;
+  EXPECT_NE(ir.str().find("switch i8"), std::string::npos);
+
+  auto module = std::move(builder).build();
+  auto interpret_ptr = module.get_address(interpret);
+
+  uint8_t program[] = {0, 1, 2, 0, 3};
+  int32_t operands[] = {2, 3, 0, 20, 0};
+  EXPECT_EQ(interpret_ptr(program, operands, 1), 11);
+  EXPECT_EQ(interpret_ptr(program, operands, -1), 17);
+
+  uint8_t invalid[] = {0, 7};
+  EXPECT_EQ(interpret_ptr(invalid, operands, 1), -1);
+}
+
+TEST(statements, switch_without_default) {
+  auto comp = codegen::compiler{};
+  auto builder = codegen::module_builder(comp, "switch_without_default");
+
+  auto classify = builder.create_function<int32_t(int32_t)>("classify", [](codegen::value<int32_t> x) {
+    auto result = codegen::variable<int32_t>("result", codegen::constant<int32_t>(0));
+    codegen::switch_(x, codegen::case_(-1, [&] { result.set(codegen::constant<int32_t>(10)); }),
+                     codegen::case_(1, [&] { result.set(codegen::constant<int32_t>(20)); }));
+    codegen::return_(result.get());
+  });
+
+  auto module = std::move(builder).build();
+  auto classify_ptr = module.get_address(classify);
+  EXPECT_EQ(classify_ptr(-1), 10);
+  EXPECT_EQ(classify_ptr(1), 20);
+  EXPECT_EQ(classify_ptr(0), 0);
+}
+
+TEST(statements, switch_invalid_cases) {
+  auto comp = codegen::compiler{};
+  auto builder = codegen::module_builder(comp, "switch_invalid_cases");
+
+  builder.create_function<void(uint8_t)>("duplicate", [](codegen::value<uint8_t> x) {
+    EXPECT_THROW(codegen::switch_(x, codegen::case_(1, [] {}), codegen::case_(2, [] {}), codegen::case_(1, [] {})),
+                 std::invalid_argument);
+    EXPECT_THROW(codegen::switch_(x, codegen::case_(1, [] {}), codegen::case_(257, [] {})), std::invalid_argument);
+    EXPECT_THROW(codegen::switch_(x, codegen::case_(-1, [] {})), std::invalid_argument);
+    codegen::return_();
+  });
+}
+
+namespace {
+
+int32_t twice(int32_t v) {
+  return v * 2;
+}
+
+int32_t negate(int32_t v) {
+  return -v;
+}
+
+} // namespace
+
+TEST(statements, indirect_call) {
+  using callback = int32_t (*)(int32_t);
+
+  auto comp = codegen::compiler{};
+  auto builder = codegen::module_builder(comp, "indirect_call");
+
+  auto apply = builder.create_function<int32_t(callback, int32_t)>(
+      "apply", [](codegen::value<callback> fn, codegen::value<int32_t> x) {
+        codegen::return_(codegen::call(fn, x + codegen::constant<int32_t>(1)));
+      });
+  auto apply_table = builder.create_function<int32_t(callback const*, uint32_t, int32_t)>(
+      "apply_table",
+      [](codegen::value<callback const*> table, codegen::value<uint32_t> idx, codegen::value<int32_t> x) {
+        auto fn = codegen::load(table + idx);
+        codegen::return_(codegen::call(fn, codegen::call(fn, x)));
+      });
+
+  auto module = std::move(builder).build();
+
+  auto apply_ptr = module.get_address(apply);
+  EXPECT_EQ(apply_ptr(twice, 4), 10);
+  EXPECT_EQ(apply_ptr(negate, 4), -5);
+
+  callback table[] = {twice, negate};
+  auto apply_table_ptr = module.get_address(apply_table);
+  EXPECT_EQ(apply_table_ptr(table, 0, 3), 12);
+  EXPECT_EQ(apply_table_ptr(table, 1, 3), 3);
+}
+
+TEST(statements, tail_call) {
+  using handler = int64_t (*)(std::byte const*, uint8_t const*, int64_t);
+
+  auto comp = codegen::compiler{};
+  auto builder = codegen::module_builder(comp, "tail_call");
+
+  auto dispatch = [](codegen::value<std::byte const*> table, auto pc, auto acc) {
+    auto handlers = codegen::bit_cast<handler const*>(table);
+    auto next = codegen::load(handlers + codegen::cast<uint64_t>(codegen::load(pc)));
+    codegen::tail_call(next, table, pc, acc);
+  };
+
+  auto op_halt = builder.create_function<int64_t(std::byte const*, uint8_t const*, int64_t)>(
+      "op_halt", [](codegen::value<std::byte const*>, codegen::value<uint8_t const*>, codegen::value<int64_t> acc) {
+        codegen::return_(acc);
+      });
+  auto op_inc = builder.create_function<int64_t(std::byte const*, uint8_t const*, int64_t)>(
+      "op_inc",
+      [&](codegen::value<std::byte const*> table, codegen::value<uint8_t const*> pc, codegen::value<int64_t> acc) {
+        dispatch(table, pc + codegen::constant<uint64_t>(1), acc + codegen::constant<int64_t>(1));
+      });
+  auto op_dec = builder.create_function<int64_t(std::byte const*, uint8_t const*, int64_t)>(
+      "op_dec",
+      [&](codegen::value<std::byte const*> table, codegen::value<uint8_t const*> pc, codegen::value<int64_t> acc) {
+        dispatch(table, pc + codegen::constant<uint64_t>(1), acc - codegen::constant<int64_t>(1));
+      });
+  auto start = builder.create_function<int64_t(std::byte const*, uint8_t const*, int64_t)>(
+      "start",
+      [&](codegen::value<std::byte const*> table, codegen::value<uint8_t const*> pc, codegen::value<int64_t> acc) {
+        dispatch(table, pc, acc);
+      });
+  auto run = builder.create_function<int64_t(std::byte const*, uint8_t const*, int64_t)>(
+      "run",
+      [&](codegen::value<std::byte const*> table, codegen::value<uint8_t const*> pc, codegen::value<int64_t> acc) {
+        codegen::tail_call(start, table, pc, acc);
+      });
+
+  auto ir = std::stringstream{};
+  ir << builder;
+  EXPECT_EQ(count_instructions(ir.str(), "op_inc", "musttail"), 1);
+  EXPECT_EQ(count_instructions(ir.str(), "run", "musttail"), 1);
+
+  auto module = std::move(builder).build();
+
+  handler table[] = {module.get_address(op_halt), module.get_address(op_inc), module.get_address(op_dec)};
+  auto program = std::vector<uint8_t>{};
+  for (auto i = 0; i < 1'000'000; i++) { program.insert(program.end(), {1, 1, 2}); }
+  program.push_back(0);
+
+  auto run_ptr = module.get_address(run);
+  EXPECT_EQ(run_ptr(reinterpret_cast<std::byte const*>(table), program.data(), 5), 1'000'005);
+}
+
+TEST(statements, tail_call_entry_points) {
+  auto comp = codegen::compiler{};
+  auto optimized_ir = std::string{};
+  comp.set_optimized_ir_handler([&](std::string const& ir) { optimized_ir = ir; });
+  auto builder = codegen::module_builder(comp, "tail_call_entry_points");
+
+  // run is an entry point and keeps the C calling convention, so start, which it tail calls, has to keep it as well.
+  // middle and leaf are linked by a tail call too, but both of them can switch to fastcc.
+  auto noinline = codegen::function_attributes{}.noinline();
+  auto leaf = builder.create_function<int64_t(int64_t, int64_t)>(
+      "leaf", [](codegen::value<int64_t> a, codegen::value<int64_t> b) { codegen::return_(a * b); }, noinline);
+  auto middle = builder.create_function<int64_t(int64_t, int64_t)>(
+      "middle",
+      [&](codegen::value<int64_t> a, codegen::value<int64_t> b) {
+        codegen::tail_call(leaf, a + codegen::constant<int64_t>(1), b);
+      },
+      noinline);
+  auto start = builder.create_function<int64_t(int64_t, int64_t)>(
+      "start",
+      [&](codegen::value<int64_t> a, codegen::value<int64_t> b) {
+        codegen::return_(codegen::call(middle, a, b) + codegen::constant<int64_t>(1));
+      },
+      noinline);
+  auto run = builder.create_function<int64_t(int64_t, int64_t)>(
+      "run", [&](codegen::value<int64_t> a, codegen::value<int64_t> b) { codegen::tail_call(start, a, b); });
+
+  auto module = std::move(builder).build({run});
+  EXPECT_EQ(module.get_address(run)(4, 6), 31);
+
+  EXPECT_NE(optimized_ir.find("define internal i64 @start("), std::string::npos);
+  EXPECT_NE(optimized_ir.find("define internal fastcc i64 @middle("), std::string::npos);
+  EXPECT_NE(optimized_ir.find("define internal fastcc i64 @leaf("), std::string::npos);
+}
+
+TEST(statements, generator) {
+  auto comp = codegen::compiler{};
+  auto builder = codegen::module_builder(comp, "generator");
+
+  auto squares = builder.create_generator<int32_t(int32_t, int32_t)>(
+      "squares", [&](codegen::value<int32_t> n, codegen::value<int32_t> limit) {
+        codegen::for_(codegen::constant<int32_t>(0), n, codegen::constant<int32_t>(1), [&](codegen::value<int32_t> i) {
+          auto square = codegen::let(i * i);
+          codegen::if_(square > limit, [&] { codegen::return_(); });
+          codegen::yield_(square);
+        });
+      });
+
+  auto sum_squares = builder.create_function<int32_t(int32_t, int32_t)>(
+      "sum_squares", [&](codegen::value<int32_t> n, codegen::value<int32_t> limit) {
+        auto frame = codegen::array_variable<std::byte, 256>("frame", 16);
+        auto frame_size = codegen::array_variable<uint64_t, 1>("frame_size");
+        auto out = codegen::array_variable<int32_t, 1>("out");
+        auto sum = codegen::variable<int32_t>("sum", codegen::constant<int32_t>(0));
+        frame_size.set(codegen::constant<int32_t>(0), codegen::constant<uint64_t>(256));
+        auto handle = codegen::call(squares.start, frame.data(), frame_size.data(), n, limit);
+        codegen::while_([&] { return codegen::call(squares.next, handle, out.data()); },
+                        [&] { sum.set(sum.get() + out.get(codegen::constant<int32_t>(0))); });
+        codegen::return_(sum.get());
+      });
+
+  auto module = std::move(builder).build();
+
+  auto start_ptr = module.get_address(squares.start);
+  auto next_ptr = module.get_address(squares.next);
+
+  auto frame_size = uint64_t(0);
+  EXPECT_EQ(start_ptr(nullptr, &frame_size, 10, 1000), nullptr);
+  EXPECT_NE(frame_size, 0);
+  ASSERT_LE(frame_size, 256);
+
+  auto run = [&](int32_t n, int32_t limit) {
+    alignas(16) std::byte frame[256];
+    auto size = uint64_t(sizeof(frame));
+    auto handle = start_ptr(frame, &size, n, limit);
+    EXPECT_NE(handle, nullptr);
+    auto values = std::vector<int32_t>{};
+    auto value = int32_t{};
+    while (next_ptr(handle, &value)) { values.emplace_back(value); }
+    EXPECT_FALSE(next_ptr(handle, &value));
+    return values;
+  };
+  EXPECT_EQ(run(5, 1000), (std::vector<int32_t>{0, 1, 4, 9, 16}));
+  EXPECT_EQ(run(10, 50), (std::vector<int32_t>{0, 1, 4, 9, 16, 25, 36, 49}));
+  EXPECT_EQ(run(0, 50), std::vector<int32_t>{});
+
+  auto sum_squares_ptr = module.get_address(sum_squares);
+  EXPECT_EQ(sum_squares_ptr(5, 1000), 30);
+  EXPECT_EQ(sum_squares_ptr(10, 50), 140);
+}
+
 TEST(statements, while_loop) {
   auto comp = codegen::compiler{};
   auto builder = codegen::module_builder(comp, "while_loop");
@@ -25,9 +25,12 @@
 #include <gtest/gtest.h>
 
 #include "codegen/arithmetic_ops.hpp"
+#include "codegen/builtin.hpp"
 #include "codegen/compiler.hpp"
 #include "codegen/module.hpp"
 #include "codegen/module_builder.hpp"
+#include "codegen/relational_ops.hpp"
+#include "codegen/statements.hpp"
 
 TEST(variable, set_get) {
   auto comp = codegen::compiler{};
@@ -48,3 +51,63 @@ TEST(variable, set_get) {
   auto set_get_ptr = module.get_address(set_get);
   EXPECT_EQ(set_get_ptr(8), 13);
 }
+
+TEST(variable, array) {
+  auto comp = codegen::compiler{};
+  auto builder = codegen::module_builder(comp, "array");
+
+  auto array = builder.create_function<int32_t(int32_t, int32_t)>(
+      "array_fn", [](codegen::value<int32_t> x, codegen::value<int32_t> y) {
+        auto arr = codegen::array_variable<int32_t, 4>{"arr"};
+        arr.set(codegen::constant<uint32_t>(0), x);
+        arr.set(codegen::constant<uint32_t>(1), y);
+        arr.set(codegen::constant<uint32_t>(2), x * y);
+        arr.set(codegen::constant<uint32_t>(3), x - y);
+        auto idx = codegen::variable<int32_t>{"idx", codegen::constant<int32_t>(0)};
+        auto sum = codegen::variable<int32_t>{"sum", codegen::constant<int32_t>(0)};
+        codegen::while_([&] { return idx.get() < codegen::constant<int32_t>(4); },
+                        [&] {
+                          sum.set(sum.get() + arr.get(idx.get()));
+                          idx.set(idx.get() + codegen::constant<int32_t>(1));
+                        });
+        codegen::return_(sum.get());
+      });
+
+  auto module = std::move(builder).build();
+
+  auto array_ptr = module.get_address(array);
+  EXPECT_EQ(array_ptr(3, 5), 3 + 5 + 15 - 2);
+  EXPECT_EQ(array_ptr(-1, 7), -1 + 7 - 7 - 8);
+}
+
+TEST(variable, buffer) {
+  auto comp = codegen::compiler{};
+  auto builder = codegen::module_builder(comp, "buffer");
+
+  auto reverse = builder.create_function<void(uint16_t*, uint32_t)>(
+      "reverse", [](codegen::value<uint16_t*> ptr, codegen::value<uint32_t> n) {
+        auto buf = codegen::buffer_variable<uint16_t, 64, uint32_t>{"buf", n, 32};
+        codegen::builtin::memcpy(codegen::bit_cast<std::byte*>(buf.data()), codegen::bit_cast<std::byte*>(ptr),
+                                 codegen::cast<int64_t>(buf.size() * codegen::constant<uint32_t>(2)));
+        auto idx = codegen::variable<uint32_t>{"idx", codegen::constant<uint32_t>(0)};
+        codegen::while_([&] { return idx.get() < buf.size(); },
+                        [&] {
+                          auto i = idx.get();
+                          codegen::store(buf.get(buf.size() - i - codegen::constant<uint32_t>(1)), ptr + i);
+                          idx.set(i + codegen::constant<uint32_t>(1));
+                        });
+        codegen::return_();
+      });
+
+  auto module = std::move(builder).build();
+
+  auto reverse_ptr = module.get_address(reverse);
+  uint16_t data[] = {1, 2, 3, 4, 5, 6, 7};
+  reverse_ptr(data, 7);
+  for (auto i = 0u; i < 7; i++) { EXPECT_EQ(data[i], 7 - i); }
+  reverse_ptr(data, 3);
+  EXPECT_EQ(data[0], 5);
+  EXPECT_EQ(data[1], 6);
+  EXPECT_EQ(data[2], 7);
+  EXPECT_EQ(data[3], 4);
+}
@@ -0,0 +1,246 @@
+/*
+ * Copyright © 2019 Paweł Dziepak
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "codegen/vector.hpp"
+
+#include <numeric>
+
+#include <gtest/gtest.h>
+
+#include "codegen/arithmetic_ops.hpp"
+#include "codegen/compiler.hpp"
+#include "codegen/literals.hpp"
+#include "codegen/module.hpp"
+#include "codegen/module_builder.hpp"
+#include "codegen/relational_ops.hpp"
+#include "codegen/statements.hpp"
+
+namespace cg = codegen;
+using namespace cg::literals;
+
+TEST(vector, arithmetic) {
+  auto comp = cg::compiler{};
+  auto builder = cg::module_builder(comp, "vector_arithmetic");
+
+  auto madd = builder.create_function<void(int32_t const*, int32_t const*, int32_t*)>(
+      "madd", [](cg::value<int32_t const*> a, cg::value<int32_t const*> b, cg::value<int32_t*> c) {
+        auto va = cg::load(cg::bit_cast<cg::vec<int32_t, 8> const*>(a));
+        auto vb = cg::load(cg::bit_cast<cg::vec<int32_t, 8> const*>(b));
+        cg::store(va * vb + cg::broadcast<8>(1_i32), cg::bit_cast<cg::vec<int32_t, 8>*>(c));
+        cg::return_();
+      });
+
+  auto to_f32 = builder.create_function<void(int32_t const*, float*)>(
+      "to_f32", [](cg::value<int32_t const*> a, cg::value<float*> b) {
+        auto va = cg::load(cg::bit_cast<cg::vec<int32_t, 4> const*>(a));
+        cg::store(cg::cast<cg::vec<float, 4>>(va) / cg::broadcast<4>(2.0_f32), cg::bit_cast<cg::vec<float, 4>*>(b));
+        cg::return_();
+      });
+
+  auto module = std::move(builder).build();
+
+  int32_t a[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+  int32_t b[8] = {-1, 2, -3, 4, -5, 6, -7, 8};
+  int32_t c[8];
+  auto madd_ptr = module.get_address(madd);
+  madd_ptr(a, b, c);
+  for (auto i = 0; i < 8; i++) { EXPECT_EQ(c[i], a[i] * b[i] + 1); }
+
+  float d[4];
+  auto to_f32_ptr = module.get_address(to_f32);
+  to_f32_ptr(b, d);
+  for (auto i = 0; i < 4; i++) { EXPECT_EQ(d[i], b[i] / 2.f); }
+}
+
+TEST(vector, select) {
+  auto comp = cg::compiler{};
+  auto builder = cg::module_builder(comp, "vector_select");
+
+  auto replace_negative = builder.create_function<void(int32_t*, int32_t)>(
+      "replace_negative", [](cg::value<int32_t*> a, cg::value<int32_t> x) {
+        auto ptr = cg::bit_cast<cg::vec<int32_t, 8>*>(a);
+        auto va = cg::load(ptr);
+        cg::store(cg::select(va < cg::broadcast<8>(0_i32), cg::broadcast<8>(x), va), ptr);
+        cg::return_();
+      });
+
+  auto module = std::move(builder).build();
+
+  int32_t a[8] = {1, -2, 3, -4, 5, -6, 7, -8};
+  auto replace_negative_ptr = module.get_address(replace_negative);
+  replace_negative_ptr(a, 42);
+  for (auto i = 0; i < 8; i++) { EXPECT_EQ(a[i], i % 2 ? 42 : i + 1); }
+}
+
+TEST(vector, lanes) {
+  auto comp = cg::compiler{};
+  auto builder = cg::module_builder(comp, "vector_lanes");
+
+  auto reverse = builder.create_function<void(uint16_t*)>("reverse", [](cg::value<uint16_t*> ptr) {
+    auto vptr = cg::bit_cast<cg::vec<uint16_t, 4>*>(ptr);
+    auto v = cg::load(vptr);
+    cg::store(cg::shuffle<3, 2, 1, 0>(v), vptr);
+    cg::return_();
+  });
+
+  auto interleave = builder.create_function<void(uint16_t const*, uint16_t const*, uint16_t*)>(
+      "interleave", [](cg::value<uint16_t const*> a, cg::value<uint16_t const*> b, cg::value<uint16_t*> c) {
+        auto va = cg::load(cg::bit_cast<cg::vec<uint16_t, 4> const*>(a));
+        auto vb = cg::load(cg::bit_cast<cg::vec<uint16_t, 4> const*>(b));
+        cg::store(cg::shuffle<0, 4, 1, 5, 2, 6, 3, 7>(va, vb), cg::bit_cast<cg::vec<uint16_t, 8>*>(c));
+        cg::return_();
+      });
+
+  auto swap_lane = builder.create_function<uint16_t(uint16_t*, uint32_t, uint16_t)>(
+      "swap_lane", [](cg::value<uint16_t*> ptr, cg::value<uint32_t> idx, cg::value<uint16_t> x) {
+        auto vptr = cg::bit_cast<cg::vec<uint16_t, 4>*>(ptr);
+        auto v = cg::load(vptr);
+        cg::store(cg::insert(v, idx, x), vptr);
+        cg::return_(cg::extract(v, idx));
+      });
+
+  auto module = std::move(builder).build();
+
+  uint16_t a[4] = {1, 2, 3, 4};
+  auto reverse_ptr = module.get_address(reverse);
+  reverse_ptr(a);
+  EXPECT_EQ(a[0], 4);
+  EXPECT_EQ(a[1], 3);
+  EXPECT_EQ(a[2], 2);
+  EXPECT_EQ(a[3], 1);
+
+  uint16_t b[4] = {5, 6, 7, 8};
+  uint16_t c[8];
+  auto interleave_ptr = module.get_address(interleave);
+  interleave_ptr(a, b, c);
+  for (auto i = 0; i < 4; i++) {
+    EXPECT_EQ(c[i * 2], a[i]);
+    EXPECT_EQ(c[i * 2 + 1], b[i]);
+  }
+
+  auto swap_lane_ptr = module.get_address(swap_lane);
+  EXPECT_EQ(swap_lane_ptr(b, 2, 11), 7);
+  EXPECT_EQ(b[2], 11);
+  EXPECT_EQ(swap_lane_ptr(b, 0, 12), 5);
+  EXPECT_EQ(b[0], 12);
+}
+
+TEST(vector, reductions) {
+  auto comp = cg::compiler{};
+  auto builder = cg::module_builder(comp, "vector_reductions");
+
+  auto sum = builder.create_function<int32_t(int32_t const*)>("sum", [](cg::value<int32_t const*> ptr) {
+    cg::return_(cg::reduce_add(cg::load(cg::bit_cast<cg::vec<int32_t, 8> const*>(ptr))));
+  });
+
+  auto min = builder.create_function<int32_t(int32_t const*)>("min", [](cg::value<int32_t const*> ptr) {
+    cg::return_(cg::reduce_min(cg::load(cg::bit_cast<cg::vec<int32_t, 8> const*>(ptr))));
+  });
+
+  auto max = builder.create_function<float(float const*)>("max", [](cg::value<float const*> ptr) {
+    cg::return_(cg::reduce_max(cg::load(cg::bit_cast<cg::vec<float, 4> const*>(ptr))));
+  });
+
+  auto any_eq = builder.create_function<bool(int32_t const*, int32_t)>(
+      "any_eq", [](cg::value<int32_t const*> ptr, cg::value<int32_t> x) {
+        cg::return_(cg::any(cg::load(cg::bit_cast<cg::vec<int32_t, 8> const*>(ptr)) == cg::broadcast<8>(x)));
+      });
+
+  auto all_gt = builder.create_function<bool(int32_t const*, int32_t)>(
+      "all_gt", [](cg::value<int32_t const*> ptr, cg::value<int32_t> x) {
+        cg::return_(cg::all(cg::load(cg::bit_cast<cg::vec<int32_t, 8> const*>(ptr)) > cg::broadcast<8>(x)));
+      });
+
+  auto module = std::move(builder).build();
+
+  int32_t a[8] = {4, -2, 7, 1, 9, 3, 0, 5};
+  EXPECT_EQ(module.get_address(sum)(a), 27);
+  EXPECT_EQ(module.get_address(min)(a), -2);
+
+  float b[4] = {1.5f, -3.f, 8.25f, 2.f};
+  EXPECT_EQ(module.get_address(max)(b), 8.25f);
+
+  auto any_eq_ptr = module.get_address(any_eq);
+  EXPECT_TRUE(any_eq_ptr(a, 9));
+  EXPECT_FALSE(any_eq_ptr(a, 8));
+
+  auto all_gt_ptr = module.get_address(all_gt);
+  EXPECT_TRUE(all_gt_ptr(a, -3));
+  EXPECT_FALSE(all_gt_ptr(a, -2));
+}
+
+TEST(vector, masked_memory) {
+  auto comp = cg::compiler{};
+  auto builder = cg::module_builder(comp, "vector_masked_memory");
+
+  auto copy_positive = builder.create_function<void(int32_t const*, int32_t*)>(
+      "copy_positive", [](cg::value<int32_t const*> src, cg::value<int32_t*> dst) {
+        auto zero = cg::broadcast<8>(0_i32);
+        auto v = cg::masked_load(src, cg::load(cg::bit_cast<cg::vec<int32_t, 8> const*>(src)) > zero, zero);
+        cg::masked_store(v, dst, v > zero);
+        cg::return_();
+      });
+
+  auto lookup = builder.create_function<void(uint64_t const*, uint32_t const*, uint32_t const*, uint64_t*)>(
+      "lookup", [](cg::value<uint64_t const*> table, cg::value<uint32_t const*> idx, cg::value<uint32_t const*> pos,
+                   cg::value<uint64_t*> out) {
+        auto indices = cg::load(cg::bit_cast<cg::vec<uint32_t, 4> const*>(idx));
+        auto positions = cg::load(cg::bit_cast<cg::vec<uint32_t, 4> const*>(pos));
+        auto valid = indices < cg::broadcast<4>(8_u32);
+        auto values = cg::gather(table, indices, valid, cg::broadcast<4>(0_u64));
+        cg::scatter(values, out, positions, valid);
+        cg::return_();
+      });
+
+  auto select_even = builder.create_function<uint32_t(uint32_t const*, uint32_t*)>(
+      "select_even", [](cg::value<uint32_t const*> src, cg::value<uint32_t*> dst) {
+        auto v = cg::load(cg::bit_cast<cg::vec<uint32_t, 8> const*>(src));
+        cg::return_(cg::compress_store(v, dst, (v & cg::broadcast<8>(1_u32)) == cg::broadcast<8>(0_u32)));
+      });
+
+  auto module = std::move(builder).build();
+
+  int32_t a[8] = {4, -2, 7, 1, -9, 3, 0, 5};
+  int32_t b[8] = {-1, -1, -1, -1, -1, -1, -1, -1};
+  module.get_address(copy_positive)(a, b);
+  for (auto i = 0; i < 8; i++) { EXPECT_EQ(b[i], a[i] > 0 ? a[i] : -1); }
+
+  uint64_t table[8];
+  std::iota(std::begin(table), std::end(table), 100);
+  uint32_t idx[4] = {3, 0, 9, 5};
+  uint32_t pos[4] = {3, 2, 1, 0};
+  uint64_t out[4] = {0, 0, 0, 0};
+  module.get_address(lookup)(table, idx, pos, out);
+  EXPECT_EQ(out[0], 105);
+  EXPECT_EQ(out[1], 0);
+  EXPECT_EQ(out[2], 100);
+  EXPECT_EQ(out[3], 103);
+
+  uint32_t c[8] = {2, 3, 8, 10, 7, 1, 4, 5};
+  uint32_t d[8] = {};
+  EXPECT_EQ(module.get_address(select_even)(c, d), 4);
+  EXPECT_EQ(d[0], 2);
+  EXPECT_EQ(d[1], 8);
+  EXPECT_EQ(d[2], 10);
+  EXPECT_EQ(d[3], 4);
+  EXPECT_EQ(d[4], 0);
+}